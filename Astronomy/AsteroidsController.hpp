@@ -1,31 +1,40 @@
 #pragma once
+#include <algorithm>
 #include <random>
 #include "IDrawable.hpp"
+#include "VertexFormat.hpp"
+#include "GpuMemory.hpp"
 #define SEED 123
 
-class Asteroid :public IDrawable
+class Asteroid
 {
 public:
-    Asteroid(std::mt19937& generator, glm::vec3 position, glm::vec3 color, float scale_factor)
-        :g(generator), position(position), color(color), scale_factor(scale_factor)
+    static const GLuint VerticesCount = 36;
+    static constexpr double MaxExtent = 2.4;
+
+    Asteroid(std::mt19937& generator, std::vector<PositionNormalVertex>& geometry, glm::vec3 position, glm::vec3 color, float scale_factor)
+        :g(generator), position(position), color(color), scale_factor(scale_factor),
+         first(static_cast<GLuint>(geometry.size()))
     {
-        vertices.reserve(216);
-        create_triangles();
-        prepare_graphics_data();
+        create_triangles(geometry);
     }
 
-    void Draw(Shader& shader) override
+    ObjectInstance getInstance() const
     {
-        glBindVertexArray(VAO);
-
         glm::mat4 m = glm::mat4(1.0f);
         m = glm::translate(m, position);
         m = glm::scale(m, glm::vec3(scale_factor, scale_factor, scale_factor));
-        shader.setMat4("model", m);
-        shader.setVec3("objectColor", color);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        return ObjectInstance{ m, color };
+    }
 
-        glBindVertexArray(0);
+    glm::vec4 getBounds() const
+    {
+        return glm::vec4(position, scale_factor * static_cast<float>(MaxExtent * glm::sqrt(3.0)));
+    }
+
+    DrawArraysIndirectCommand getDrawCommand(GLuint baseVertex, GLuint instance) const
+    {
+        return DrawArraysIndirectCommand{ VerticesCount, 1, baseVertex + first, instance };
     }
 
     glm::vec3 position;
@@ -33,14 +42,12 @@ public:
     float scale_factor;
 
 private:
-    GLuint VBO, VAO;
-    
-    std::vector<float> vertices;
     std::mt19937& g;
+    GLuint first;
     
-    void create_triangles()
+    void create_triangles(std::vector<PositionNormalVertex>& vertices)
     {
-        std::uniform_real_distribution<> p(0.7, 2.4);
+        std::uniform_real_distribution<> p(0.7, MaxExtent);
         
         glm::vec3 v_tmp[8]
         {
@@ -55,87 +62,162 @@ private:
 
         }; 
 
-        add_triangle(0, 3, 1, v_tmp);
-        add_triangle(0, 2, 3, v_tmp);
-        add_triangle(0, 4, 6, v_tmp);
-        add_triangle(0, 6, 2, v_tmp);
-        add_triangle(2, 6, 7, v_tmp);
-        add_triangle(2, 7, 3, v_tmp);
-        add_triangle(3, 7, 5, v_tmp);
-        add_triangle(3, 5, 1, v_tmp);
-        add_triangle(6, 4, 5, v_tmp);
-        add_triangle(6, 5, 7, v_tmp);
-        add_triangle(4, 0, 1, v_tmp);
-        add_triangle(4, 1, 5, v_tmp);
+        add_triangle(0, 3, 1, v_tmp, vertices);
+        add_triangle(0, 2, 3, v_tmp, vertices);
+        add_triangle(0, 4, 6, v_tmp, vertices);
+        add_triangle(0, 6, 2, v_tmp, vertices);
+        add_triangle(2, 6, 7, v_tmp, vertices);
+        add_triangle(2, 7, 3, v_tmp, vertices);
+        add_triangle(3, 7, 5, v_tmp, vertices);
+        add_triangle(3, 5, 1, v_tmp, vertices);
+        add_triangle(6, 4, 5, v_tmp, vertices);
+        add_triangle(6, 5, 7, v_tmp, vertices);
+        add_triangle(4, 0, 1, v_tmp, vertices);
+        add_triangle(4, 1, 5, v_tmp, vertices);
     }
 
-    void add_triangle(int v1, int v2, int v3, glm::vec3 tmp[])
+    void add_triangle(int v1, int v2, int v3, glm::vec3 tmp[], std::vector<PositionNormalVertex>& vertices)
     {
         glm::vec3 U = tmp[v2] - tmp[v1];
         glm::vec3 V = tmp[v3] - tmp[v1];
 
         glm::vec3 normal = glm::cross(U, V);
 
-        add_vertices(tmp[v1]);
-        add_normal(normal);
-
-        add_vertices(tmp[v2]);
-        add_normal(normal);
-        
-        add_vertices(tmp[v3]);
-        add_normal(normal);
+        vertices.push_back({ tmp[v1], normal });
+        vertices.push_back({ tmp[v2], normal });
+        vertices.push_back({ tmp[v3], normal });
     }
+};
 
-    void add_vertices(glm::vec3 vec)
+class AsteroidsController :public IDrawable
+{
+public:
+    AsteroidsController()
     {
-        vertices.push_back(vec.x);
-        vertices.push_back(vec.y);
-        vertices.push_back(vec.z);
+        generate();
+        prepare_graphics_data();
     }
 
-    void add_normal(glm::vec3 normal)
+    ~AsteroidsController()
     {
-        vertices.push_back(normal.x);
-        vertices.push_back(normal.y);
-        vertices.push_back(normal.z);
+        GLState::deleteVertexArray(VAO);
+        GeometryMemory::release(geometryRange_);
+        GLState::deleteBuffer(instanceVBO);
+        GLState::deleteBuffer(indirectBuffer);
+        GLState::deleteBuffer(shadowCommands);
+        GLState::deleteBuffer(boundsBuffer);
     }
 
-    void prepare_graphics_data()
+    AsteroidsController(const AsteroidsController&) = delete;
+    AsteroidsController& operator=(const AsteroidsController&) = delete;
+
+    void Cull(GpuCuller& culler, const RenderContext& context) override
     {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
+        if (context.colors.shadingLod)
+            updateShading(context);
 
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+        if (context.colors.culling != CPU_CULLING)
+        {
+            culler.cullCommands(boundsBuffer, indirectBuffer, static_cast<GLsizei>(asteroids_.size()), sizeof(DrawArraysIndirectCommand));
+            return;
+        }
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3*sizeof(float)));
-        glEnableVertexAttribArray(1); 
+        FrustumCuller::cull(context.frustum, spheres_, visible_);
+        for (auto& command : commands_)
+            command.instanceCount = 0;
+        for (uint32_t index : visible_)
+            commands_[index].instanceCount = 1;
 
-        glBindVertexArray(0);
+        GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands_.size() * sizeof(DrawArraysIndirectCommand), commands_.data());
     }
-};
 
-class AsteroidsController :public IDrawable
-{
-public:
-    AsteroidsController()
+    void Submit(RenderQueue& queue, const RenderContext& context) override
     {
-        generate();
+        GLsizei count = static_cast<GLsizei>(asteroids_.size());
+        if (!context.colors.shadingLod)
+        {
+            submitRange(queue, context, context.shader(ShaderPermutation::ASTEROID), 0, count);
+            return;
+        }
+        submitRange(queue, context, context.lodShader(ShaderPermutation::ASTEROID, false), 0, phongCount_);
+        submitRange(queue, context, context.lodShader(ShaderPermutation::ASTEROID, true), phongCount_, count - phongCount_);
     }
 
-    void Draw(Shader& shader) override
+    void SubmitShadow(RenderQueue& queue, const RenderContext& context, ShadowLayer layer) override
     {
-        for (int i=0; i<AsteroidsCount; ++i)
-            asteroids_[i].Draw(shader);
+        if (layer != STATIC_CASTERS || asteroids_.empty())
+            return;
+        DrawPacket packet = DrawPacket::arraysIndirect(VAO, GL_TRIANGLES, shadowCommands, static_cast<GLsizei>(asteroids_.size()));
+        packet.shader = packet.depthShader = &context.depthShader(ShaderPermutation::ASTEROID);
+        queue.submit(packet);
     }
 private:
     static const int AsteroidsCount = 256;
     std::mt19937 generator = std::mt19937(SEED);
     std::vector<Asteroid> asteroids_;
+    std::vector<PositionNormalVertex> geometry_;
+    std::vector<DrawArraysIndirectCommand> commands_;
+    SphereSet spheres_;
+    std::vector<uint32_t> visible_;
+    std::vector<bool> gouraud_;
+    GLsizei phongCount_;
+    Geometry geometryRange_;
+    GLuint VAO, instanceVBO, indirectBuffer, shadowCommands, boundsBuffer;
+
+    void submitRange(RenderQueue& queue, const RenderContext& context, Shader& shader, GLsizei first, GLsizei count)
+    {
+        if (count == 0)
+            return;
+        DrawPacket packet = DrawPacket::arraysIndirect(VAO, GL_TRIANGLES, indirectBuffer, count, first * sizeof(DrawArraysIndirectCommand));
+        packet.shader = &shader;
+        packet.depthShader = &context.depthShader(ShaderPermutation::ASTEROID);
+        queue.submit(packet);
+    }
+
+    void updateShading(const RenderContext& context)
+    {
+        bool changed = false;
+        for (uint32_t i = 0; i < asteroids_.size(); ++i)
+        {
+            glm::vec4 bounds = asteroids_[i].getBounds();
+            float radius = context.projectedRadius(glm::vec3(bounds), bounds.w);
+            bool gouraud = ShadingLod::selectGouraud(gouraud_[i], radius);
+            changed |= gouraud != gouraud_[i];
+            gouraud_[i] = gouraud;
+            if (gouraud && context.frustum.intersects(bounds))
+                context.shadingLod->addSaved(radius);
+        }
+        if (changed)
+            rebuild_shading_order();
+    }
+
+    // Phong asteroids first, Gouraud ones after them, so each program draws one contiguous command range
+    void rebuild_shading_order()
+    {
+        std::vector<uint32_t> order;
+        order.reserve(asteroids_.size());
+        for (bool gouraud : { false, true })
+            for (uint32_t i = 0; i < asteroids_.size(); ++i)
+                if (gouraud_[i] == gouraud)
+                    order.push_back(i);
+        phongCount_ = static_cast<GLsizei>(std::count(gouraud_.begin(), gouraud_.end(), false));
+
+        std::vector<glm::vec4> bounds;
+        bounds.reserve(order.size());
+        for (uint32_t slot = 0; slot < order.size(); ++slot)
+        {
+            const Asteroid& asteroid = asteroids_[order[slot]];
+            commands_[slot] = asteroid.getDrawCommand(geometryRange_.vertices.offset, order[slot]);
+            bounds.push_back(asteroid.getBounds());
+            spheres_.set(slot, bounds.back());
+        }
+
+        GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands_.size() * sizeof(DrawArraysIndirectCommand), commands_.data());
+        GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bounds.size() * sizeof(glm::vec4), bounds.data());
+    }
 
     void generate()
     {
@@ -144,13 +226,50 @@ private:
         std::uniform_real_distribution<> position_z(-10, 100);
         std::uniform_real_distribution<> color(0.05, 0.1);
         
+        asteroids_.reserve(AsteroidsCount);
+        geometry_.reserve(AsteroidsCount * Asteroid::VerticesCount);
         for (int i = 0; i < AsteroidsCount; ++i)
             asteroids_.emplace_back(
                 generator,
+                geometry_,
                 glm::vec3(position_x(generator), position_x(generator), position_z(generator)),
                 glm::vec3(0.58, 0.3, color(generator)),
                 scale(generator)
             ); 
     }
 
-};
\ No newline at end of file
+    void prepare_graphics_data()
+    {
+        // without geometry there is nothing to point the draw commands at
+        if (!GeometryMemory::upload(geometry_, geometryRange_))
+        {
+            std::cout << "ERROR::ASTEROIDS::GEOMETRY_NOT_UPLOADED " << asteroids_.size() << " asteroids dropped" << std::endl;
+            asteroids_.clear();
+        }
+        VAO = GeometryMemory::createVertexArray<PositionNormalVertex>();
+
+        std::vector<ObjectInstance> instances;
+        std::vector<glm::vec4> bounds;
+        instances.reserve(asteroids_.size());
+        commands_.reserve(asteroids_.size());
+        bounds.reserve(asteroids_.size());
+        spheres_.reserve(asteroids_.size());
+        for (auto& asteroid : asteroids_)
+        {
+            commands_.push_back(asteroid.getDrawCommand(geometryRange_.vertices.offset, static_cast<GLuint>(instances.size())));
+            instances.push_back(asteroid.getInstance());
+            bounds.push_back(asteroid.getBounds());
+            spheres_.add(asteroid.getBounds());
+        }
+
+        attachInstanceBuffer(VAO, instances, instanceVBO);
+        createBuffer(GL_DRAW_INDIRECT_BUFFER, commands_, indirectBuffer, GL_DYNAMIC_DRAW);
+        createBuffer(GL_DRAW_INDIRECT_BUFFER, commands_, shadowCommands);
+        createBuffer(GL_SHADER_STORAGE_BUFFER, bounds, boundsBuffer, GL_DYNAMIC_DRAW);
+        gouraud_.assign(asteroids_.size(), false);
+        phongCount_ = static_cast<GLsizei>(asteroids_.size());
+
+        geometry_.clear();
+        geometry_.shrink_to_fit();
+    }
+};
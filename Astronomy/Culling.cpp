@@ -0,0 +1,409 @@
+#include "Culling.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CULLING_AVX2
+#if defined(_MSC_VER)
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE2
+#endif
+
+namespace
+{
+    const GLuint CullGroupSize = 64;
+    const GLuint PyramidGroupSize = 8;
+
+    enum CullBinding
+    {
+        BOUNDS = 0,
+        COMMANDS = 1,
+        INSTANCES = 2,
+        VISIBLE_INSTANCES = 3
+    };
+
+    GLuint groupsFor(int size, GLuint groupSize)
+    {
+        return (static_cast<GLuint>(size) + groupSize - 1) / groupSize;
+    }
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection)
+{
+    glm::mat4 rows = glm::transpose(viewProjection);
+    Frustum frustum = { {
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2]
+    } };
+    for (glm::vec4& plane : frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+bool Frustum::intersects(const glm::vec4& sphere) const
+{
+    for (const glm::vec4& plane : planes)
+        if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w)
+            return false;
+    return true;
+}
+
+void SphereSet::clear()
+{
+    size_ = 0;
+    x_.clear();
+    y_.clear();
+    z_.clear();
+    radius_.clear();
+}
+
+void SphereSet::reserve(size_t count)
+{
+    size_t padded = (count + Lanes - 1) / Lanes * Lanes;
+    x_.reserve(padded);
+    y_.reserve(padded);
+    z_.reserve(padded);
+    radius_.reserve(padded);
+}
+
+uint32_t SphereSet::add(const glm::vec4& sphere)
+{
+    if (size_ == x_.size())
+    {
+        x_.resize(size_ + Lanes, 0.0f);
+        y_.resize(size_ + Lanes, 0.0f);
+        z_.resize(size_ + Lanes, 0.0f);
+        radius_.resize(size_ + Lanes, 0.0f);
+    }
+
+    uint32_t index = static_cast<uint32_t>(size_++);
+    set(index, sphere);
+    return index;
+}
+
+void SphereSet::set(uint32_t index, const glm::vec4& sphere)
+{
+    x_[index] = sphere.x;
+    y_[index] = sphere.y;
+    z_[index] = sphere.z;
+    radius_[index] = sphere.w;
+}
+
+size_t SphereSet::size() const
+{
+    return size_;
+}
+
+namespace
+{
+    typedef void (*CullFunction)(const Frustum&, const SphereSet&, std::vector<uint32_t>&);
+
+    struct CullPath
+    {
+        const char* name;
+        CullFunction cull;
+    };
+
+    void emitVisible(unsigned int mask, uint32_t base, size_t size, std::vector<uint32_t>& visible)
+    {
+        for (uint32_t lane = 0; mask; ++lane, mask >>= 1)
+            if ((mask & 1) && base + lane < size)
+                visible.push_back(base + lane);
+    }
+
+#ifdef CULLING_AVX2
+    AVX2_TARGET void cullAvx2(const Frustum& frustum, const SphereSet& spheres, std::vector<uint32_t>& visible)
+    {
+        visible.clear();
+        for (size_t i = 0; i < spheres.size(); i += 8)
+        {
+            __m256 x = _mm256_loadu_ps(spheres.x() + i);
+            __m256 y = _mm256_loadu_ps(spheres.y() + i);
+            __m256 z = _mm256_loadu_ps(spheres.z() + i);
+            __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius() + i));
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (const glm::vec4& plane : frustum.planes)
+            {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), x), _mm256_mul_ps(_mm256_set1_ps(plane.y), y));
+                distance = _mm256_add_ps(_mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.z), z)), _mm256_set1_ps(plane.w));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+            }
+            emitVisible(static_cast<unsigned int>(_mm256_movemask_ps(inside)), static_cast<uint32_t>(i), spheres.size(), visible);
+        }
+        _mm256_zeroupper();
+    }
+
+    // AVX2 in the CPU and YMM state enabled by the OS
+    bool cpuSupportsAvx2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        const int osxsave = 1 << 27, avx = 1 << 28;
+        if ((info[2] & (osxsave | avx)) != (osxsave | avx) || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }
+#endif
+
+#ifdef CULLING_SSE2
+    void cullSse2(const Frustum& frustum, const SphereSet& spheres, std::vector<uint32_t>& visible)
+    {
+        visible.clear();
+        for (size_t i = 0; i < spheres.size(); i += 4)
+        {
+            __m128 x = _mm_loadu_ps(spheres.x() + i);
+            __m128 y = _mm_loadu_ps(spheres.y() + i);
+            __m128 z = _mm_loadu_ps(spheres.z() + i);
+            __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius() + i));
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const glm::vec4& plane : frustum.planes)
+            {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y));
+                distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), z)), _mm_set1_ps(plane.w));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+            }
+            emitVisible(static_cast<unsigned int>(_mm_movemask_ps(inside)), static_cast<uint32_t>(i), spheres.size(), visible);
+        }
+    }
+#endif
+
+    // widest first; the build only needs SSE2, AVX2 is picked at run time
+    std::vector<CullPath> availablePaths()
+    {
+        std::vector<CullPath> paths;
+#ifdef CULLING_AVX2
+        if (cpuSupportsAvx2())
+            paths.push_back(CullPath{ "AVX2", &cullAvx2 });
+#endif
+#ifdef CULLING_SSE2
+        paths.push_back(CullPath{ "SSE2", &cullSse2 });
+#endif
+        paths.push_back(CullPath{ "scalar", &FrustumCuller::cullScalar });
+        return paths;
+    }
+
+    const CullPath& selectedPath()
+    {
+        static const CullPath path = availablePaths().front();
+        return path;
+    }
+}
+
+void FrustumCuller::cullScalar(const Frustum& frustum, const SphereSet& spheres, std::vector<uint32_t>& visible)
+{
+    visible.clear();
+    for (size_t i = 0; i < spheres.size(); ++i)
+    {
+        bool inside = true;
+        for (const glm::vec4& plane : frustum.planes)
+            inside = inside && plane.x * spheres.x()[i] + plane.y * spheres.y()[i] + plane.z * spheres.z()[i] + plane.w >= -spheres.radius()[i];
+        if (inside)
+            visible.push_back(static_cast<uint32_t>(i));
+    }
+}
+
+void FrustumCuller::cull(const Frustum& frustum, const SphereSet& spheres, std::vector<uint32_t>& visible)
+{
+    selectedPath().cull(frustum, spheres, visible);
+}
+
+const char* FrustumCuller::instructionSet()
+{
+    return selectedPath().name;
+}
+
+void FrustumCuller::benchmark(size_t count, int iterations)
+{
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+
+    SphereSet spheres;
+    spheres.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        spheres.add(glm::vec4(position(generator), position(generator), position(generator), radius(generator)));
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = Frustum::fromMatrix(projection * view);
+
+    std::vector<uint32_t> scalarVisible, simdVisible;
+    auto measure = [&](CullFunction cull, std::vector<uint32_t>& visible) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            cull(frustum, spheres, visible);
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+        return elapsed.count() / (static_cast<double>(iterations) * count);
+    };
+
+    double scalar = measure(&FrustumCuller::cullScalar, scalarVisible);
+
+    std::cout << "FRUSTUM_CULLING::BENCHMARK " << count << " spheres x " << iterations << " iterations, cull() uses "
+              << instructionSet() << std::endl;
+    std::cout << "  scalar: " << scalar << " ns/sphere" << std::endl;
+    for (const CullPath& path : availablePaths())
+    {
+        if (path.cull == &FrustumCuller::cullScalar)
+            continue;
+        double simd = measure(path.cull, simdVisible);
+        std::cout << "  " << path.name << ": " << simd << " ns/sphere (" << scalar / simd << "x)"
+                  << (simdVisible == scalarVisible ? "" : " MISMATCH") << std::endl;
+    }
+    std::cout << "  visible: " << scalarVisible.size() << "/" << count << std::endl;
+}
+
+GpuCuller::GpuCuller()
+    :cull_("cull.comp"),
+    copyDepth_("depth_pyramid.comp", ShaderDefines{ { "COPY_DEPTH", "" } }),
+    reduceDepth_("depth_pyramid.comp")
+{
+    copyDepth_.bindSampler("depthBuffer", 0);
+    cull_.bindSampler("depthPyramid", 0);
+}
+
+GpuCuller::~GpuCuller()
+{
+    GLState::deleteTexture(depthTexture_);
+    GLState::deleteTexture(pyramid_);
+}
+
+void GpuCuller::beginFrame(const glm::mat4& viewProjection, bool enabled)
+{
+    viewProjection_ = viewProjection;
+    enabled_ = enabled;
+
+    cull_.use();
+    cull_.setMat4("viewProjection", viewProjection_);
+    cull_.setMat4("previousViewProjection", pyramidViewProjection_);
+    cull_.setBool("enabled", enabled_);
+    cull_.setBool("occlusion", enabled_ && pyramidValid_);
+}
+
+void GpuCuller::cullCommands(GLuint bounds, GLuint commands, GLsizei count, GLsizei commandSize)
+{
+    cull_.use();
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS, commands);
+    cull_.setInt("commandWord", 0);
+    cull_.setInt("commandStride", commandSize / sizeof(GLuint));
+    cull_.setInt("instanceWords", 0);
+    dispatch(bounds, 0, count);
+}
+
+void GpuCuller::cullInstances(GLuint bounds, GLuint first, GLsizei count, GLuint instances, GLsizei instanceSize,
+                              GLuint visibleInstances, GLuint commands, GLintptr commandOffset, bool elements)
+{
+    const GLuint zero = 0;
+    const GLintptr instanceCountOffset = commandOffset + sizeof(GLuint);
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, commands);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, instanceCountOffset, sizeof(GLuint),
+                         GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    cull_.use();
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS, commands);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCES, instances);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_INSTANCES, visibleInstances);
+    cull_.setInt("commandWord", static_cast<int>(commandOffset / sizeof(GLuint)));
+    cull_.setInt("instanceWords", instanceSize / sizeof(GLuint));
+    cull_.setInt("baseInstanceWord", elements ? 4 : 3);
+    dispatch(bounds, first, count);
+}
+
+void GpuCuller::finishCulling()
+{
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuCuller::dispatch(GLuint bounds, GLuint first, GLsizei count)
+{
+    if (count <= 0)
+        return;
+
+    GLState::bindTexture(0, GL_TEXTURE_2D, pyramid_);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, BOUNDS, bounds);
+    cull_.setInt("first", static_cast<int>(first));
+    cull_.setInt("count", count);
+    glDispatchCompute(groupsFor(count, CullGroupSize), 1, 1);
+}
+
+void GpuCuller::buildDepthPyramid(int width, int height)
+{
+    if (!enabled_ || width <= 0 || height <= 0)
+    {
+        pyramidValid_ = false;
+        return;
+    }
+    if (width != width_ || height != height_)
+        resize(width, height);
+
+    GLState::bindTexture(0, GL_TEXTURE_2D, depthTexture_);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width_, height_);
+
+    copyDepth_.use();
+    glBindImageTexture(1, pyramid_, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute(groupsFor(width_, PyramidGroupSize), groupsFor(height_, PyramidGroupSize), 1);
+
+    reduceDepth_.use();
+    for (int level = 1; level < levels_; ++level)
+    {
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        glBindImageTexture(0, pyramid_, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, pyramid_, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute(groupsFor(std::max(width_ >> level, 1), PyramidGroupSize),
+                          groupsFor(std::max(height_ >> level, 1), PyramidGroupSize), 1);
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    pyramidViewProjection_ = viewProjection_;
+    pyramidValid_ = true;
+}
+
+void GpuCuller::resize(int width, int height)
+{
+    GLState::deleteTexture(depthTexture_);
+    GLState::deleteTexture(pyramid_);
+
+    width_ = width;
+    height_ = height;
+    levels_ = 1;
+    while ((std::max(width_, height_) >> levels_) > 0)
+        ++levels_;
+
+    glGenTextures(1, &depthTexture_);
+    GLState::bindTexture(0, GL_TEXTURE_2D, depthTexture_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, width_, height_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &pyramid_);
+    GLState::bindTexture(0, GL_TEXTURE_2D, pyramid_);
+    glTexStorage2D(GL_TEXTURE_2D, levels_, GL_R32F, width_, height_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    pyramidValid_ = false;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "Shader.hpp"
+
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+    bool intersects(const glm::vec4& sphere) const;
+};
+
+// Bounding spheres stored as separate x/y/z/radius arrays, padded to the SIMD width.
+class SphereSet
+{
+public:
+    static const size_t Lanes = 8;
+
+    void clear();
+    void reserve(size_t count);
+    uint32_t add(const glm::vec4& sphere);
+    void set(uint32_t index, const glm::vec4& sphere);
+    size_t size() const;
+
+    const float* x() const { return x_.data(); }
+    const float* y() const { return y_.data(); }
+    const float* z() const { return z_.data(); }
+    const float* radius() const { return radius_.data(); }
+
+private:
+    size_t size_ = 0;
+    std::vector<float> x_, y_, z_, radius_;
+};
+
+class FrustumCuller
+{
+public:
+    static void cull(const Frustum& frustum, const SphereSet& spheres, std::vector<uint32_t>& visible);
+    static void cullScalar(const Frustum& frustum, const SphereSet& spheres, std::vector<uint32_t>& visible);
+    static const char* instructionSet();
+    static void benchmark(size_t count, int iterations);
+};
+
+class GpuCuller
+{
+public:
+    GpuCuller();
+    ~GpuCuller();
+
+    GpuCuller(const GpuCuller&) = delete;
+    GpuCuller& operator=(const GpuCuller&) = delete;
+
+    void beginFrame(const glm::mat4& viewProjection, bool enabled);
+    void cullCommands(GLuint bounds, GLuint commands, GLsizei count, GLsizei commandSize);
+    void cullInstances(GLuint bounds, GLuint first, GLsizei count, GLuint instances, GLsizei instanceSize,
+                       GLuint visibleInstances, GLuint commands, GLintptr commandOffset, bool elements);
+    void finishCulling();
+    void buildDepthPyramid(int width, int height);
+
+private:
+    Shader cull_;
+    Shader copyDepth_;
+    Shader reduceDepth_;
+    GLuint depthTexture_ = 0;
+    GLuint pyramid_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    int levels_ = 0;
+    bool enabled_ = true;
+    bool pyramidValid_ = false;
+    glm::mat4 viewProjection_;
+    glm::mat4 pyramidViewProjection_;
+
+    void dispatch(GLuint bounds, GLuint first, GLsizei count);
+    void resize(int width, int height);
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <string>
 #include "Camera.hpp"
 
 struct CoordinatesData
@@ -22,10 +23,23 @@ struct WindowData
     std::string title = "Astronomy";
 };
 
+enum CullingMode
+{
+    GPU_CULLING,
+    CPU_CULLING,
+    NO_CULLING
+};
+
 struct ColoringData
 {
     bool gouraud = false;
     bool blinn = false;
+    bool impostors = false;
+    CullingMode culling = CPU_CULLING;
+    bool depthPrepass = false;
+    bool shadingLod = false;
+    bool lightingCache = false;
+    int bloomLevels = 4;
     glm::vec3 background = glm::vec3(0.1f, 0.1f, 0.1f);
     glm::vec3 sun_direction = glm::vec3(0.0f, -1.0f, 0.0f);
     float ambient_strength = 0.05f;
@@ -78,6 +92,8 @@ struct PointLight
     float constant;
     float linear;
     float quadratic;
+
+    float sourceRadius = 0.0f;
 };
 
 struct CasterLight {
@@ -94,49 +110,3 @@ struct CasterLight {
     float linear;
     float quadratic;
 };
-
-struct ShadersPack
-{
-    Shader sphereShader;
-    Shader asteroidShader;
-    Shader spaceshipShader;
-
-    Shader sphereShader_g;
-    Shader asteroidShader_g;
-    Shader spaceshipShader_g;
-
-    ShadersPack()
-        :sphereShader("object.vert", "sphere.frag"),
-        asteroidShader("object.vert", "asteroid.frag"),
-        spaceshipShader("object.vert", "spaceship.frag"),
-        sphereShader_g("sphere_g.vert", "object_g.frag"),
-        asteroidShader_g("asteroid_g.vert", "object_g.frag"),
-        spaceshipShader_g("spaceship_g.vert", "object_g.frag")
-    {
-        
-    }
-
-    Shader& getAsteroidShader(bool gouraud)
-    {
-        if (gouraud)
-            return asteroidShader_g;
-        
-        return asteroidShader;
-    }
-
-    Shader& getSpaceshipShader(bool gouraud)
-    {
-        if (gouraud)
-            return spaceshipShader_g;
-        
-        return spaceshipShader;
-    }
-
-    Shader& getSphereShader(bool gouraud)
-    {
-        if (gouraud)
-            return sphereShader_g;
-
-        return sphereShader;
-    }
-};
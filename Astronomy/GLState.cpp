@@ -0,0 +1,254 @@
+#include "GLState.hpp"
+
+GLuint GLState::program_ = GLState::Unknown;
+GLuint GLState::vao_ = GLState::Unknown;
+GLuint GLState::activeUnit_ = GLState::Unknown;
+GLuint GLState::buffers_[BUFFER_TARGET_COUNT];
+GLuint GLState::textures_[MaxTextureUnits][TEXTURE_TARGET_COUNT];
+std::unordered_map<GLenum, bool> GLState::capabilities_;
+GLenum GLState::depthFunc_ = GLState::Unknown;
+GLuint GLState::depthMask_ = GLState::Unknown;
+GLuint GLState::colorMask_ = GLState::Unknown;
+GLenum GLState::blendSource_ = GLState::Unknown;
+GLenum GLState::blendDestination_ = GLState::Unknown;
+unsigned int GLState::changes_ = 0;
+unsigned int GLState::skipped_ = 0;
+unsigned int GLState::frameChanges_ = 0;
+unsigned int GLState::frameSkipped_ = 0;
+
+namespace
+{
+    struct StateInitializer
+    {
+        StateInitializer() { GLState::invalidate(); }
+    } stateInitializer;
+}
+
+bool GLState::changed(GLuint& cached, GLuint value)
+{
+    if (cached == value)
+    {
+        ++skipped_;
+        return false;
+    }
+    cached = value;
+    ++changes_;
+    return true;
+}
+
+void GLState::useProgram(GLuint program)
+{
+    if (changed(program_, program))
+        glUseProgram(program);
+}
+
+void GLState::bindVertexArray(GLuint vao)
+{
+    if (changed(vao_, vao))
+    {
+        glBindVertexArray(vao);
+        buffers_[ELEMENT_ARRAY_BUFFER] = Unknown;
+    }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+    int index = bufferIndex(target);
+    if (index < 0)
+    {
+        ++changes_;
+        glBindBuffer(target, buffer);
+    }
+    else if (changed(buffers_[index], buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    ++changes_;
+    glBindBufferBase(target, index, buffer);
+
+    int cached = bufferIndex(target);
+    if (cached >= 0)
+        buffers_[cached] = buffer;
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    ++changes_;
+    glBindBufferRange(target, index, buffer, offset, size);
+
+    int cached = bufferIndex(target);
+    if (cached >= 0)
+        buffers_[cached] = buffer;
+}
+
+void GLState::activeTexture(GLuint unit)
+{
+    if (changed(activeUnit_, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    int index = textureIndex(target);
+    if (index < 0 || unit >= MaxTextureUnits)
+    {
+        activeTexture(unit);
+        ++changes_;
+        glBindTexture(target, texture);
+        return;
+    }
+
+    if (textures_[unit][index] == texture)
+    {
+        ++skipped_;
+        return;
+    }
+    activeTexture(unit);
+    textures_[unit][index] = texture;
+    ++changes_;
+    glBindTexture(target, texture);
+}
+
+void GLState::setEnabled(GLenum capability, bool enabled)
+{
+    auto it = capabilities_.find(capability);
+    if (it != capabilities_.end() && it->second == enabled)
+    {
+        ++skipped_;
+        return;
+    }
+
+    capabilities_[capability] = enabled;
+    ++changes_;
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void GLState::depthFunc(GLenum func)
+{
+    if (changed(depthFunc_, func))
+        glDepthFunc(func);
+}
+
+void GLState::depthMask(GLboolean mask)
+{
+    if (changed(depthMask_, mask))
+        glDepthMask(mask);
+}
+
+void GLState::colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+    GLuint mask = (red ? 1 : 0) | (green ? 2 : 0) | (blue ? 4 : 0) | (alpha ? 8 : 0);
+    if (changed(colorMask_, mask))
+        glColorMask(red, green, blue, alpha);
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination)
+{
+    if (blendSource_ == source && blendDestination_ == destination)
+    {
+        ++skipped_;
+        return;
+    }
+    blendSource_ = source;
+    blendDestination_ = destination;
+    ++changes_;
+    glBlendFunc(source, destination);
+}
+
+void GLState::deleteProgram(GLuint program)
+{
+    if (program_ == program)
+        program_ = Unknown;
+    glDeleteProgram(program);
+}
+
+void GLState::deleteVertexArray(GLuint vao)
+{
+    if (vao_ == vao)
+        vao_ = 0;
+    glDeleteVertexArrays(1, &vao);
+}
+
+void GLState::deleteBuffer(GLuint buffer)
+{
+    for (GLuint& bound : buffers_)
+        if (bound == buffer)
+            bound = 0;
+    glDeleteBuffers(1, &buffer);
+}
+
+void GLState::deleteTexture(GLuint texture)
+{
+    for (auto& unit : textures_)
+        for (GLuint& bound : unit)
+            if (bound == texture)
+                bound = 0;
+    glDeleteTextures(1, &texture);
+}
+
+void GLState::invalidate()
+{
+    program_ = Unknown;
+    vao_ = Unknown;
+    activeUnit_ = Unknown;
+    for (GLuint& bound : buffers_)
+        bound = Unknown;
+    for (auto& unit : textures_)
+        for (GLuint& bound : unit)
+            bound = Unknown;
+    capabilities_.clear();
+    depthFunc_ = Unknown;
+    depthMask_ = Unknown;
+    colorMask_ = Unknown;
+    blendSource_ = blendDestination_ = Unknown;
+}
+
+void GLState::beginFrame()
+{
+    frameChanges_ = changes_;
+    frameSkipped_ = skipped_;
+    changes_ = 0;
+    skipped_ = 0;
+}
+
+unsigned int GLState::getFrameChanges()
+{
+    return frameChanges_;
+}
+
+unsigned int GLState::getFrameSkipped()
+{
+    return frameSkipped_;
+}
+
+int GLState::bufferIndex(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER: return ARRAY_BUFFER;
+    case GL_ELEMENT_ARRAY_BUFFER: return ELEMENT_ARRAY_BUFFER;
+    case GL_UNIFORM_BUFFER: return UNIFORM_BUFFER;
+    case GL_SHADER_STORAGE_BUFFER: return SHADER_STORAGE_BUFFER;
+    case GL_DRAW_INDIRECT_BUFFER: return DRAW_INDIRECT_BUFFER;
+    case GL_DISPATCH_INDIRECT_BUFFER: return DISPATCH_INDIRECT_BUFFER;
+    case GL_COPY_READ_BUFFER: return COPY_READ_BUFFER;
+    case GL_COPY_WRITE_BUFFER: return COPY_WRITE_BUFFER;
+    default: return -1;
+    }
+}
+
+int GLState::textureIndex(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D: return TEXTURE_2D;
+    case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP;
+    case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY;
+    default: return -1;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <glad/glad.h>
+#include <unordered_map>
+
+class GLState
+{
+public:
+    static const GLuint MaxTextureUnits = 32;
+
+    static void useProgram(GLuint program);
+    static void bindVertexArray(GLuint vao);
+    static void bindBuffer(GLenum target, GLuint buffer);
+    static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    static void setEnabled(GLenum capability, bool enabled);
+    static void depthFunc(GLenum func);
+    static void depthMask(GLboolean mask);
+    static void colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+    static void blendFunc(GLenum source, GLenum destination);
+
+    static void deleteProgram(GLuint program);
+    static void deleteVertexArray(GLuint vao);
+    static void deleteBuffer(GLuint buffer);
+    static void deleteTexture(GLuint texture);
+
+    static void invalidate();
+    static void beginFrame();
+    static unsigned int getFrameChanges();
+    static unsigned int getFrameSkipped();
+
+private:
+    enum BufferTarget
+    {
+        ARRAY_BUFFER,
+        ELEMENT_ARRAY_BUFFER,
+        UNIFORM_BUFFER,
+        SHADER_STORAGE_BUFFER,
+        DRAW_INDIRECT_BUFFER,
+        DISPATCH_INDIRECT_BUFFER,
+        COPY_READ_BUFFER,
+        COPY_WRITE_BUFFER,
+        BUFFER_TARGET_COUNT
+    };
+
+    enum TextureTarget
+    {
+        TEXTURE_2D,
+        TEXTURE_CUBE_MAP,
+        TEXTURE_2D_ARRAY,
+        TEXTURE_TARGET_COUNT
+    };
+
+    static const GLuint Unknown = ~0u;
+
+    static GLuint program_;
+    static GLuint vao_;
+    static GLuint activeUnit_;
+    static GLuint buffers_[BUFFER_TARGET_COUNT];
+    static GLuint textures_[MaxTextureUnits][TEXTURE_TARGET_COUNT];
+    static std::unordered_map<GLenum, bool> capabilities_;
+    static GLenum depthFunc_;
+    static GLuint depthMask_;
+    static GLuint colorMask_;
+    static GLenum blendSource_, blendDestination_;
+    static unsigned int changes_, skipped_;
+    static unsigned int frameChanges_, frameSkipped_;
+
+    static bool changed(GLuint& cached, GLuint value);
+    static void activeTexture(GLuint unit);
+    static int bufferIndex(GLenum target);
+    static int textureIndex(GLenum target);
+};
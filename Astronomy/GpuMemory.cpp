@@ -0,0 +1,210 @@
+#include "GpuMemory.hpp"
+#include <algorithm>
+#include <iostream>
+
+BuddyAllocator::BuddyAllocator(GLuint capacity)
+    :maxOrder_(0)
+{
+    while ((2u << maxOrder_) <= capacity && maxOrder_ < 31)
+        ++maxOrder_;
+    freeLists_.resize(maxOrder_ + 1);
+    if (capacity > 0)
+        freeLists_[maxOrder_].insert(0);
+}
+
+int BuddyAllocator::orderFor(GLuint count)
+{
+    int order = 0;
+    while ((1u << order) < count)
+        ++order;
+    return order;
+}
+
+bool BuddyAllocator::allocate(GLuint count, GLuint& offset)
+{
+    int order = orderFor(std::max(count, 1u));
+    int available = order;
+    while (available <= maxOrder_ && freeLists_[available].empty())
+        ++available;
+    if (available > maxOrder_)
+        return false;
+
+    offset = *freeLists_[available].begin();
+    freeLists_[available].erase(freeLists_[available].begin());
+    while (available > order)
+    {
+        --available;
+        freeLists_[available].insert(offset + (1u << available));
+    }
+
+    allocated_[offset] = order;
+    used_ += 1u << order;
+    return true;
+}
+
+void BuddyAllocator::free(GLuint offset)
+{
+    auto it = allocated_.find(offset);
+    if (it == allocated_.end())
+    {
+        std::cout << "ERROR::BUDDY_ALLOCATOR::INVALID_FREE " << offset << std::endl;
+        return;
+    }
+
+    int order = it->second;
+    allocated_.erase(it);
+    used_ -= 1u << order;
+
+    while (order < maxOrder_)
+    {
+        GLuint buddy = offset ^ (1u << order);
+        auto found = freeLists_[order].find(buddy);
+        if (found == freeLists_[order].end())
+            break;
+        freeLists_[order].erase(found);
+        offset = std::min(offset, buddy);
+        ++order;
+    }
+    freeLists_[order].insert(offset);
+}
+
+GLuint BuddyAllocator::capacity() const
+{
+    return freeLists_.empty() ? 0 : 1u << maxOrder_;
+}
+
+GLuint BuddyAllocator::used() const
+{
+    return used_;
+}
+
+GLuint BuddyAllocator::largestFree() const
+{
+    for (int order = maxOrder_; order >= 0; --order)
+        if (!freeLists_[order].empty())
+            return 1u << order;
+    return 0;
+}
+
+GpuBufferPool::GpuBufferPool(const std::string& name, GLsizeiptr unitSize, GLsizeiptr budget)
+    :name_(name), unitSize_(unitSize), allocator_(static_cast<GLuint>(budget / unitSize))
+{
+    GLsizeiptr size = allocator_.capacity() * unitSize_;
+    glGenBuffers(1, &buffer_);
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    if (GLAD_GL_VERSION_4_4)
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    else
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+}
+
+GpuBufferPool::~GpuBufferPool()
+{
+    GLState::deleteBuffer(buffer_);
+}
+
+bool GpuBufferPool::allocate(const void* data, GLsizeiptr size, BufferRange& range)
+{
+    GLuint count = static_cast<GLuint>((size + unitSize_ - 1) / unitSize_);
+    if (!allocator_.allocate(count, range.offset))
+    {
+        std::cout << "ERROR::GPU_MEMORY::OUT_OF_MEMORY " << name_ << " requested " << size << " bytes" << std::endl;
+        report();
+        range = BufferRange();
+        return false;
+    }
+    range.count = count;
+
+    GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, range.offset * unitSize_, size, data);
+    return true;
+}
+
+void GpuBufferPool::free(BufferRange& range)
+{
+    if (range.count == 0)
+        return;
+    allocator_.free(range.offset);
+    range = BufferRange();
+}
+
+void GpuBufferPool::report() const
+{
+    std::cout << "GPU_MEMORY::" << name_ << ": " << allocator_.used() * unitSize_ / 1024 << " / "
+              << allocator_.capacity() * unitSize_ / 1024 << " KB used, largest free block "
+              << allocator_.largestFree() * unitSize_ / 1024 << " KB" << std::endl;
+}
+
+GLuint GpuBufferPool::getBuffer() const
+{
+    return buffer_;
+}
+
+const std::string& GpuBufferPool::getName() const
+{
+    return name_;
+}
+
+GpuBufferPool& GeometryMemory::indexPool()
+{
+    return pool("indices", sizeof(GLuint), IndexBudget);
+}
+
+std::vector<std::unique_ptr<GpuBufferPool>>& GeometryMemory::pools()
+{
+    static std::vector<std::unique_ptr<GpuBufferPool>> pools;
+    return pools;
+}
+
+// pools are created on first use and looked up by name, so nothing keeps a reference past shutdown()
+GpuBufferPool& GeometryMemory::pool(const std::string& name, GLsizeiptr unitSize, GLsizeiptr budget)
+{
+    for (auto& pool : pools())
+        if (pool->getName() == name)
+            return *pool;
+    pools().push_back(std::unique_ptr<GpuBufferPool>(new GpuBufferPool(name, unitSize, budget)));
+    return *pools().back();
+}
+
+// 16-bit indices are packed two per 32-bit unit of the shared index buffer
+bool GeometryMemory::uploadIndices(const std::vector<unsigned int>& indices, size_t vertexCount, Geometry& geometry)
+{
+    geometry.indexCount = static_cast<GLsizei>(indices.size());
+    if (vertexCount > MaxShortIndexVertices)
+    {
+        geometry.indexType = GL_UNSIGNED_INT;
+        if (!indexPool().allocate(indices.data(), indices.size() * sizeof(GLuint), geometry.indices))
+            return false;
+        geometry.firstIndex = geometry.indices.offset;
+        return true;
+    }
+
+    std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+    geometry.indexType = GL_UNSIGNED_SHORT;
+    if (!indexPool().allocate(shortIndices.data(), shortIndices.size() * sizeof(GLushort), geometry.indices))
+        return false;
+    geometry.firstIndex = geometry.indices.offset * 2;
+    return true;
+}
+
+void GeometryMemory::release(Geometry& geometry)
+{
+    if (geometry.indices.count == 0 && !geometry.vertexPool)
+        return;
+    if (geometry.vertexPool)
+        geometry.vertexPool->free(geometry.vertices);
+    if (geometry.indices.count > 0)
+        indexPool().free(geometry.indices);
+    geometry = Geometry();
+}
+
+void GeometryMemory::report()
+{
+    for (auto& pool : pools())
+        pool->report();
+}
+
+void GeometryMemory::shutdown()
+{
+    pools().clear();
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <glad/glad.h>
+#include <memory>
+#include <set>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+#include "GLState.hpp"
+#include "VertexFormat.hpp"
+
+// Power-of-two buddy allocator over [0, capacity) units.
+class BuddyAllocator
+{
+public:
+    explicit BuddyAllocator(GLuint capacity);
+
+    bool allocate(GLuint count, GLuint& offset);
+    void free(GLuint offset);
+
+    GLuint capacity() const;
+    GLuint used() const;
+    GLuint largestFree() const;
+
+private:
+    int maxOrder_;
+    GLuint used_ = 0;
+    std::vector<std::set<GLuint>> freeLists_;
+    std::unordered_map<GLuint, int> allocated_;
+
+    static int orderFor(GLuint count);
+};
+
+struct BufferRange
+{
+    GLuint offset = 0;
+    GLuint count = 0;
+};
+
+// One immutable buffer with a fixed budget, handed out in units of unitSize bytes.
+class GpuBufferPool
+{
+public:
+    GpuBufferPool(const std::string& name, GLsizeiptr unitSize, GLsizeiptr budget);
+    ~GpuBufferPool();
+
+    GpuBufferPool(const GpuBufferPool&) = delete;
+    GpuBufferPool& operator=(const GpuBufferPool&) = delete;
+
+    bool allocate(const void* data, GLsizeiptr size, BufferRange& range);
+    void free(BufferRange& range);
+    void report() const;
+
+    GLuint getBuffer() const;
+    const std::string& getName() const;
+
+private:
+    std::string name_;
+    GLsizeiptr unitSize_;
+    GLuint buffer_;
+    BuddyAllocator allocator_;
+};
+
+struct Geometry
+{
+    GpuBufferPool* vertexPool = nullptr;
+    BufferRange vertices;
+    BufferRange indices;
+    GLint baseVertex = 0;
+    GLuint firstIndex = 0;
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+};
+
+// Shared vertex buffers (one per vertex format) and a shared index buffer for all static geometry.
+class GeometryMemory
+{
+public:
+    static const GLsizeiptr VertexBudget = 16 << 20;
+    static const GLsizeiptr IndexBudget = 8 << 20;
+
+    template<typename V>
+    static GpuBufferPool& vertexPool()
+    {
+        return pool(std::string("vertices ") + typeid(V).name(), sizeof(V), VertexBudget);
+    }
+
+    static GpuBufferPool& indexPool();
+
+    template<typename V>
+    static GLuint createVertexArray()
+    {
+        GLuint VAO;
+        glGenVertexArrays(1, &VAO);
+        GLState::bindVertexArray(VAO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, vertexPool<V>().getBuffer());
+        bindVertexLayout<V>();
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexPool().getBuffer());
+        return VAO;
+    }
+
+    template<typename V>
+    static GLuint sharedVertexArray()
+    {
+        static GLuint VAO = createVertexArray<V>();
+        return VAO;
+    }
+
+    template<typename V>
+    static bool upload(const std::vector<V>& vertices, Geometry& geometry)
+    {
+        GpuBufferPool& pool = vertexPool<V>();
+        if (!pool.allocate(vertices.data(), vertices.size() * sizeof(V), geometry.vertices))
+            return false;
+        geometry.vertexPool = &pool;
+        geometry.baseVertex = static_cast<GLint>(geometry.vertices.offset);
+        return true;
+    }
+
+    template<typename V>
+    static bool upload(const std::vector<V>& vertices, const std::vector<unsigned int>& indices, Geometry& geometry)
+    {
+        if (!upload(vertices, geometry))
+            return false;
+        if (uploadIndices(indices, vertices.size(), geometry))
+            return true;
+        release(geometry);
+        return false;
+    }
+
+    static void release(Geometry& geometry);
+    static void report();
+    // deletes every pool buffer; run after all geometry is released and before the GL context goes away
+    static void shutdown();
+
+private:
+    static std::vector<std::unique_ptr<GpuBufferPool>>& pools();
+    static GpuBufferPool& pool(const std::string& name, GLsizeiptr unitSize, GLsizeiptr budget);
+    static bool uploadIndices(const std::vector<unsigned int>& indices, size_t vertexCount, Geometry& geometry);
+};
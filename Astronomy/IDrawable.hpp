@@ -1,9 +1,20 @@
 #pragma once
 #include "Shader.hpp"
+#include "RenderQueue.hpp"
+
+enum ShadowLayer
+{
+    STATIC_CASTERS,
+    DYNAMIC_CASTERS
+};
 
 class IDrawable
 {
 public:
-    virtual void Draw(Shader& shader) = 0;
+    virtual void Cull(GpuCuller& /*culler*/, const RenderContext& /*context*/) {}
+    virtual void Submit(RenderQueue& queue, const RenderContext& context) = 0;
+    virtual void SubmitShadow(RenderQueue& /*queue*/, const RenderContext& /*context*/, ShadowLayer /*layer*/) {}
+    // true when a dynamic caster moved inside or out of the frustum since the last call
+    virtual bool ShadowCastersMoved(const Frustum& /*frustum*/) { return false; }
     virtual ~IDrawable() = default;
 };
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "LightClusters.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    GLsizeiptr alignUp(GLsizeiptr size, GLsizeiptr alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    GLuint tileFor(float ndc, GLuint tiles)
+    {
+        float tile = std::floor((ndc * 0.5f + 0.5f) * tiles);
+        return static_cast<GLuint>(glm::clamp(tile, 0.0f, static_cast<float>(tiles - 1)));
+    }
+}
+
+LightClusters::LightClusters()
+    :alignment_(storageAlignment()),
+    stream_(GL_SHADER_STORAGE_BUFFER,
+            alignUp(MaxLights * sizeof(PointLightData), alignment_) +
+            alignUp(ClusterCount * sizeof(glm::uvec2), alignment_) +
+            alignUp(MaxLightIndices * sizeof(GLuint), alignment_) +
+            alignUp(MaxOccluders * sizeof(glm::vec4), alignment_))
+{
+    clusters_.resize(ClusterCount);
+}
+
+float LightClusters::lightRadius(const PointLight& light)
+{
+    glm::vec3 peak = glm::max(light.ambient, glm::max(light.diffuse, light.specular));
+    float threshold = 256.0f * std::max(peak.x, std::max(peak.y, peak.z));
+    float c = light.constant - threshold;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.quadratic > 0.0f)
+        return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+    if (light.linear > 0.0f)
+        return -c / light.linear;
+    return 1e30f;
+}
+
+void LightClusters::build(const std::vector<PointLight>& lights, const std::vector<glm::vec4>& occluders,
+                          const glm::mat4& view, const glm::mat4& projection, glm::uvec4& clusterGrid, glm::vec4& clusterDepth)
+{
+    float zNear = projection[3][2] / (projection[2][2] - 1.0f);
+    float zFar = projection[3][2] / (projection[2][2] + 1.0f);
+    float scale = Slices / std::log(zFar / zNear);
+    float bias = -std::log(zNear) * scale;
+    auto sliceFor = [&](float depth) {
+        float slice = std::floor(std::log(depth) * scale + bias);
+        return static_cast<GLuint>(glm::clamp(slice, 0.0f, static_cast<float>(Slices - 1)));
+    };
+
+    if (lights.size() > MaxLights)
+        std::cout << "ERROR::LIGHT_CLUSTERS::TOO_MANY_LIGHTS " << lights.size() << " > " << MaxLights << std::endl;
+
+    lights_.clear();
+    ranges_.clear();
+    occluders_.clear();
+    for (const PointLight& light : lights)
+    {
+        if (lights_.size() == MaxLights)
+            break;
+
+        float radius = lightRadius(light);
+        lights_.push_back(PointLightData{ light.position, radius, light.ambient, light.constant,
+                                          light.diffuse, light.linear, light.specular, light.quadratic,
+                                          0, 0, light.sourceRadius, 0.0f });
+        cullOccluders(lights_.back(), occluders);
+
+        glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        float nearest = -center.z - radius;
+        float farthest = -center.z + radius;
+        if (farthest < zNear || nearest > zFar)
+            continue;
+
+        LightRange range{ glm::uvec3(0, 0, sliceFor(std::max(nearest, zNear))),
+                          glm::uvec3(TilesX - 1, TilesY - 1, sliceFor(std::min(farthest, zFar))),
+                          static_cast<GLuint>(lights_.size() - 1) };
+
+        // a box around the sphere that stays in front of the near plane projects to a conservative screen rectangle
+        if (nearest > zNear)
+        {
+            glm::vec2 low(1e30f), high(-1e30f);
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+                glm::vec4 clip = projection * glm::vec4(center + offset, 1.0f);
+                glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                low = glm::min(low, ndc);
+                high = glm::max(high, ndc);
+            }
+            if (high.x < -1.0f || high.y < -1.0f || low.x > 1.0f || low.y > 1.0f)
+                continue;
+            range.first.x = tileFor(low.x, TilesX);
+            range.first.y = tileFor(low.y, TilesY);
+            range.last.x = tileFor(high.x, TilesX);
+            range.last.y = tileFor(high.y, TilesY);
+        }
+        ranges_.push_back(range);
+    }
+
+    for (auto& cluster : clusters_)
+        cluster = glm::uvec2(0);
+    auto forEachCluster = [&](const LightRange& range, auto&& visit) {
+        for (GLuint z = range.first.z; z <= range.last.z; ++z)
+            for (GLuint y = range.first.y; y <= range.last.y; ++y)
+                for (GLuint x = range.first.x; x <= range.last.x; ++x)
+                    visit(clusters_[(z * TilesY + y) * TilesX + x]);
+    };
+
+    for (const LightRange& range : ranges_)
+        forEachCluster(range, [](glm::uvec2& cluster) { ++cluster.y; });
+
+    GLuint total = 0;
+    for (auto& cluster : clusters_)
+    {
+        cluster.x = total;
+        cluster.y = std::min(cluster.y, MaxLightIndices - total);
+        total += cluster.y;
+    }
+    if (total == MaxLightIndices)
+        std::cout << "ERROR::LIGHT_CLUSTERS::LIGHT_INDICES_EXHAUSTED" << std::endl;
+
+    indices_.resize(total);
+    std::vector<GLuint> filled(ClusterCount, 0);
+    for (const LightRange& range : ranges_)
+        forEachCluster(range, [&](glm::uvec2& cluster) {
+            GLuint& fill = filled[&cluster - clusters_.data()];
+            if (fill < cluster.y)
+                indices_[cluster.x + fill++] = range.light;
+        });
+
+    clusterGrid = glm::uvec4(TilesX, TilesY, Slices, static_cast<GLuint>(lights_.size()));
+    clusterDepth = glm::vec4(scale, bias, zNear, zFar);
+}
+
+// spheres that can shadow something within the light's radius, except the one the light sits in
+void LightClusters::cullOccluders(PointLightData& light, const std::vector<glm::vec4>& occluders)
+{
+    light.firstOccluder = static_cast<GLuint>(occluders_.size());
+    for (const glm::vec4& occluder : occluders)
+    {
+        float distance = glm::length(glm::vec3(occluder) - light.position);
+        if (distance <= occluder.w || distance - occluder.w >= light.radius)
+            continue;
+        if (occluders_.size() == MaxOccluders)
+        {
+            std::cout << "ERROR::LIGHT_CLUSTERS::OCCLUDERS_EXHAUSTED" << std::endl;
+            break;
+        }
+        occluders_.push_back(occluder);
+    }
+    light.occluderCount = static_cast<GLuint>(occluders_.size()) - light.firstOccluder;
+}
+
+void LightClusters::upload()
+{
+    stream_.beginFrame();
+    struct Section
+    {
+        Binding binding;
+        const void* data;
+        GLsizeiptr dataSize;
+    };
+    const Section sections[] = {
+        { POINT_LIGHTS, lights_.data(), static_cast<GLsizeiptr>(lights_.size() * sizeof(PointLightData)) },
+        { CLUSTERS, clusters_.data(), static_cast<GLsizeiptr>(clusters_.size() * sizeof(glm::uvec2)) },
+        { LIGHT_INDICES, indices_.data(), static_cast<GLsizeiptr>(indices_.size() * sizeof(GLuint)) },
+        { OCCLUDERS, occluders_.data(), static_cast<GLsizeiptr>(occluders_.size() * sizeof(glm::vec4)) }
+    };
+
+    // empty sections still bind a few zeroed bytes so the blocks always have storage
+    const int sectionCount = sizeof(sections) / sizeof(sections[0]);
+    GLintptr offsets[sectionCount];
+    GLsizeiptr sizes[sectionCount];
+    for (int i = 0; i < sectionCount; ++i)
+    {
+        sizes[i] = std::max<GLsizeiptr>(sections[i].dataSize, 16);
+        void* data = stream_.allocate(sizes[i], alignment_, offsets[i]);
+        if (!data)
+            return;
+        if (sections[i].dataSize > 0)
+            std::memcpy(data, sections[i].data, sections[i].dataSize);
+        else
+            std::memset(data, 0, sizes[i]);
+    }
+    stream_.finishWrites();
+    for (int i = 0; i < sectionCount; ++i)
+        GLState::bindBufferRange(GL_SHADER_STORAGE_BUFFER, sections[i].binding, stream_.getBuffer(), offsets[i], sizes[i]);
+}
+
+void LightClusters::endFrame()
+{
+    stream_.endFrame();
+}
+
+float LightClusters::getAverageLightsPerCluster() const
+{
+    return static_cast<float>(indices_.size()) / ClusterCount;
+}
+
+GLsizeiptr LightClusters::storageAlignment()
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment > 0 ? alignment : 256;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "DataContainers.hpp"
+#include "StreamBuffer.hpp"
+
+// Mirrors the std430 PointLight struct of the PointLights buffer declared in lighting.glsl.
+struct PointLightData
+{
+    glm::vec3 position;
+    float radius;
+    glm::vec3 ambient;
+    float constant;
+    glm::vec3 diffuse;
+    float linear;
+    glm::vec3 specular;
+    float quadratic;
+    GLuint firstOccluder;
+    GLuint occluderCount;
+    float sourceRadius;
+    float padding;
+};
+
+static_assert(sizeof(PointLightData) == 80, "PointLight std430 size mismatch");
+
+// Clustered forward lighting: view-space froxels with exponential depth slices, light lists built on the CPU.
+// Each light also gets the occluding spheres within its radius for analytic soft shadows.
+class LightClusters
+{
+public:
+    static const GLuint TilesX = 16;
+    static const GLuint TilesY = 9;
+    static const GLuint Slices = 24;
+    static const GLuint ClusterCount = TilesX * TilesY * Slices;
+    static const GLuint MaxLights = 1024;
+    static const GLuint MaxLightIndices = ClusterCount * 64;
+    static const GLuint MaxOccluders = 16384;
+
+    enum Binding
+    {
+        POINT_LIGHTS = 4,
+        CLUSTERS = 5,
+        LIGHT_INDICES = 6,
+        OCCLUDERS = 7
+    };
+
+    LightClusters();
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // fills clusterGrid and clusterDepth for the SceneData block
+    void build(const std::vector<PointLight>& lights, const std::vector<glm::vec4>& occluders,
+               const glm::mat4& view, const glm::mat4& projection, glm::uvec4& clusterGrid, glm::vec4& clusterDepth);
+    void upload();
+    void endFrame();
+
+    float getAverageLightsPerCluster() const;
+
+    // distance at which the light's attenuated intensity drops below one 8-bit step
+    static float lightRadius(const PointLight& light);
+
+private:
+    struct LightRange
+    {
+        glm::uvec3 first;
+        glm::uvec3 last;
+        GLuint light;
+    };
+
+    GLsizeiptr alignment_;
+    StreamBuffer stream_;
+    std::vector<PointLightData> lights_;
+    std::vector<glm::uvec2> clusters_;
+    std::vector<GLuint> indices_;
+    std::vector<glm::vec4> occluders_;
+    std::vector<LightRange> ranges_;
+
+    void cullOccluders(PointLightData& light, const std::vector<glm::vec4>& occluders);
+    static GLsizeiptr storageAlignment();
+};
@@ -0,0 +1,106 @@
+#include "LightingCache.hpp"
+#include "GLState.hpp"
+#include "LightClusters.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    const GLsizei GroupSize = 8;
+
+    bool sameLights(const std::vector<PointLight>& a, const std::vector<PointLight>& b)
+    {
+        return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(PointLight)) == 0);
+    }
+}
+
+ShaderDefines LightingCache::defines()
+{
+    return ShaderDefines{
+        { "LIGHTING_CACHE", "" },
+        { "LIGHTING_TILE_SIZE", "ivec2(" + std::to_string(TileWidth) + ", " + std::to_string(TileHeight) + ")" },
+        { "LIGHTING_TILE_COLUMNS", std::to_string(Columns) }
+    };
+}
+
+LightingCache::LightingCache()
+    :fill_("lighting_cache.comp", defines())
+{
+    const GLsizei rows = (MaxTiles + Columns - 1) / Columns;
+    glGenTextures(1, &texture_);
+    GLState::bindTexture(TextureUnit, GL_TEXTURE_2D_ARRAY, texture_);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA16F, Columns * TileWidth, rows * TileHeight, LAYER_COUNT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // zero alpha in the irradiance layer marks a tile the shaders must not read yet
+    std::vector<GLushort> zeros(Columns * TileWidth * rows * TileHeight * 4, 0);
+    for (GLint layer = 0; layer < LAYER_COUNT; ++layer)
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, Columns * TileWidth, rows * TileHeight, 1,
+                        GL_RGBA, GL_HALF_FLOAT, zeros.data());
+}
+
+LightingCache::~LightingCache()
+{
+    GLState::deleteTexture(texture_);
+}
+
+void LightingCache::update(const std::vector<glm::vec4>& spheres, const std::vector<PointLight>& lights)
+{
+    // spheres past MaxTiles get no tile, so only the cached prefix decides whether the cache is stale
+    auto cached = spheres.begin() + std::min<size_t>(spheres.size(), MaxTiles);
+    if (!std::equal(spheres.begin(), cached, spheres_.begin(), spheres_.end()) || !sameLights(lights, lights_))
+    {
+        if (spheres.size() > MaxTiles)
+            std::cout << "ERROR::LIGHTING_CACHE::TOO_MANY_SPHERES " << spheres.size() << " > " << MaxTiles << std::endl;
+        spheres_.assign(spheres.begin(), cached);
+        lights_ = lights;
+        invalidate();
+    }
+
+    GLsizei filled = 0;
+    for (GLsizei checked = 0; checked < static_cast<GLsizei>(valid_.size()) && filled < TilesPerFrame; ++checked)
+    {
+        GLsizei tile = cursor_;
+        cursor_ = (cursor_ + 1) % static_cast<GLsizei>(valid_.size());
+        if (valid_[tile])
+            continue;
+        fillTile(tile);
+        ++filled;
+    }
+    if (filled > 0)
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void LightingCache::invalidate()
+{
+    valid_.assign(spheres_.size(), false);
+    cursor_ = 0;
+}
+
+void LightingCache::fillTile(GLsizei tile)
+{
+    const glm::vec4& sphere = spheres_[tile];
+    fill_.use();
+    fill_.setInt("tile", tile);
+    fill_.setVec3("center", glm::vec3(sphere));
+    fill_.setFloat("radius", sphere.w);
+    fill_.setInt("lightCount", static_cast<int>(std::min<size_t>(lights_.size(), LightClusters::MaxLights)));
+    glBindImageTexture(0, texture_, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glDispatchCompute(TileWidth / GroupSize, TileHeight / GroupSize, 1);
+    valid_[tile] = true;
+}
+
+void LightingCache::bind() const
+{
+    GLState::bindTexture(TextureUnit, GL_TEXTURE_2D_ARRAY, texture_);
+}
+
+GLsizei LightingCache::getValidTiles() const
+{
+    return static_cast<GLsizei>(std::count(valid_.begin(), valid_.end(), true));
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "DataContainers.hpp"
+#include "Material.hpp"
+#include "Shader.hpp"
+
+// Texture-space lighting for static spheres: one latitude-longitude tile per sphere holds the point lights'
+// view-independent terms. Tiles are refilled a few per frame by a compute pass after the lights or spheres change.
+class LightingCache
+{
+public:
+    static const GLsizei TileWidth = 64;
+    static const GLsizei TileHeight = 32;
+    static const GLsizei Columns = 8;
+    static const GLsizei MaxTiles = 64;
+    static const GLsizei TilesPerFrame = 4;
+    // next to the shadow map's unit
+    static const GLuint TextureUnit = Material::SLOT_COUNT * Material::UnitsPerSlot + 1;
+
+    enum Layer
+    {
+        IRRADIANCE,
+        SPECULAR,
+        LIGHT_DIRECTION,
+        LAYER_COUNT
+    };
+
+    static const char* samplerName()
+    {
+        return "lightingCache";
+    }
+
+    static ShaderDefines defines();
+
+    LightingCache();
+    ~LightingCache();
+
+    LightingCache(const LightingCache&) = delete;
+    LightingCache& operator=(const LightingCache&) = delete;
+
+    // tile i caches spheres[i]; expects the PointLights and Occluders buffers of LightClusters to be bound
+    void update(const std::vector<glm::vec4>& spheres, const std::vector<PointLight>& lights);
+    void bind() const;
+
+    GLsizei getValidTiles() const;
+
+private:
+    Shader fill_;
+    GLuint texture_;
+    std::vector<glm::vec4> spheres_;
+    std::vector<PointLight> lights_;
+    std::vector<bool> valid_;
+    GLsizei cursor_ = 0;
+
+    void invalidate();
+    void fillTile(GLsizei tile);
+};
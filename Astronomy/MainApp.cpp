@@ -8,19 +8,32 @@ Clock        MainApp::clock_;
 FPScounter   MainApp::fps_(clock_);
 FogData      MainApp::fog_;
 ColoringData MainApp::colors_;
-Sphere PlanetsController::sphere_;
 
-MainApp::MainApp(GLFWwindow* window)
+MainApp::MainApp(GLFWwindow* window, bool starField)
     :window(window),
+    planets_(starField),
+    shader_compiler_(window),
+    drawables_{ &spaceship_, &planets_, &asteroids_ },
     day_night_cycle_(60)
 {
-    glEnable(GL_DEPTH_TEST);
+    GLState::setEnabled(GL_DEPTH_TEST, true);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     camera_.SetNewData(camera_data_.beginingPostion, camera_data_.bYaw, camera_data_.bPitch);
+
+    shaders_.bindUniformBlock(SceneUniformBuffer::blockName(), SceneUniformBuffer::BindingPoint);
+    shaders_.bindSampler(ShadowMap::samplerName(), ShadowMap::TextureUnit);
+    shaders_.bindSampler(LightingCache::samplerName(), LightingCache::TextureUnit);
+    shaders_.prefetch(ShaderPermutation(ShaderPermutation::SPACESHIP, colors_.gouraud, colors_.blinn));
+    shaders_.prefetch(ShaderPermutation(sphereObject(), colors_.gouraud, colors_.blinn, true));
+    shaders_.prefetch(ShaderPermutation(sphereObject(), colors_.gouraud, colors_.blinn));
+    shaders_.prefetch(ShaderPermutation(ShaderPermutation::ASTEROID, colors_.gouraud, colors_.blinn));
+    for (auto object : { ShaderPermutation::SPHERE, ShaderPermutation::ASTEROID, ShaderPermutation::SPACESHIP, ShaderPermutation::SPHERE_IMPOSTOR })
+        shaders_.prefetch(ShaderPermutation::depthPass(object));
+    GeometryMemory::report();
 }
 
 void MainApp::framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -71,6 +84,18 @@ void MainApp::key_callback(GLFWwindow* window, int key, int scancode, int action
         colors_.gouraud = !colors_.gouraud;
     if (key == GLFW_KEY_B && action == GLFW_RELEASE)
         colors_.blinn = !colors_.blinn;
+    if (key == GLFW_KEY_I && action == GLFW_RELEASE)
+        colors_.impostors = !colors_.impostors;
+    if (key == GLFW_KEY_C && action == GLFW_RELEASE)
+        colors_.culling = static_cast<CullingMode>((colors_.culling + 1) % (NO_CULLING + 1));
+    if (key == GLFW_KEY_Z && action == GLFW_RELEASE)
+        colors_.depthPrepass = !colors_.depthPrepass;
+    if (key == GLFW_KEY_L && action == GLFW_RELEASE)
+        colors_.shadingLod = !colors_.shadingLod;
+    if (key == GLFW_KEY_T && action == GLFW_RELEASE)
+        colors_.lightingCache = !colors_.lightingCache;
+    if (key == GLFW_KEY_N && action == GLFW_RELEASE)
+        colors_.bloomLevels = (colors_.bloomLevels + 1) % (PostProcess::MaxBloomLevels + 1);
     if (key == GLFW_KEY_K && action == GLFW_RELEASE) {
         switch (camera_data_.camera_type)
         {
@@ -99,38 +124,78 @@ void MainApp::update()
     day_night_cycle_.update(clock_.deltaTime);
     colors_.background = day_night_cycle_.getColor();
     updateCamera();
-    glfwSetWindowTitle(window, (window_data.title + " FPS:" + std::to_string(fps_.getFPS())).c_str());
+    glfwSetWindowTitle(window, (window_data.title + " FPS:" + std::to_string(fps_.getFPS()) +
+                                " GL:" + std::to_string(GLState::getFrameChanges()) +
+                                "/" + std::to_string(GLState::getFrameChanges() + GLState::getFrameSkipped()) +
+                                " DRAWS:" + std::to_string(render_queue_.getLastPacketCount()) +
+                                " SHADOWS:" + ShadowMap::updateName(caster_shadow_.getLastUpdate()) +
+                                " LIGHTS/CLUSTER:" + std::to_string(light_clusters_.getAverageLightsPerCluster()).substr(0, 4) +
+                                " BLOOM:" + std::to_string(colors_.bloomLevels) +
+                                " POST:" + std::to_string(post_process_.getLastMilliseconds()).substr(0, 4) + "ms" +
+                                (colors_.lightingCache ? " LIGHTING CACHE:" + std::to_string(lighting_cache_.getValidTiles()) + "/" +
+                                                         std::to_string(PlanetsController::planetsCount) : "") +
+                                (colors_.shadingLod ? " SHADING LOD SAVED:" + std::to_string(shading_lod_.getFrameSaved()) +
+                                                      " FRAGS TOTAL:" + std::to_string(shading_lod_.getTotalSaved() / 1000000) + "M" : "") +
+                                (colors_.depthPrepass ? " PREPASS SAVED:" + std::to_string(static_cast<int>(100.0f * render_queue_.getPrepassSavings())) + "%" : "")).c_str());
 }
 
 void MainApp::mainLoop()
 {
     while (!glfwWindowShouldClose(window))
     {
+        GLState::beginFrame();
+        render_queue_.beginFrame();
         processInput();
         update();
         updateShaders();
+        render();
 
-        glClearColor(colors_.background.r,
-                     colors_.background.g,
-                     colors_.background.b,
-                     1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+}
 
-        Shader& spaceshipShader = shaders_.getSpaceshipShader(colors_.gouraud);
-        spaceshipShader.use();
-        spaceship_.Draw(spaceshipShader);
+ShaderPermutation::Object MainApp::sphereObject()
+{
+    return colors_.impostors ? ShaderPermutation::SPHERE_IMPOSTOR : ShaderPermutation::SPHERE;
+}
 
-        Shader& sphereShader = shaders_.getSphereShader(colors_.gouraud);
-        sphereShader.use();
-        planets_.Draw(sphereShader);
+void MainApp::renderShadows()
+{
+    if (caster_shadow_.needsUpdate(drawables_))
+    {
+        scene_buffer_.bind(SceneUniformBuffer::CASTER_SHADOW_VIEW);
+        RenderContext context{ shaders_, colors_, caster_shadow_.getView(), caster_shadow_.getFrustum(), caster_shadow_.getPixelScale(), nullptr };
+        caster_shadow_.render(drawables_, render_queue_, context);
+        glViewport(0, 0, window_data.width, window_data.height);
+        scene_buffer_.bind(SceneUniformBuffer::CAMERA_VIEW);
+    }
+    caster_shadow_.bind();
+}
 
-        Shader& asteroidShader = shaders_.getAsteroidShader(colors_.gouraud);
-        asteroidShader.use();
-        asteroids_.Draw(asteroidShader);
+void MainApp::render()
+{
+    renderShadows();
+    lighting_cache_.bind();
+    post_process_.beginScene(window_data.width, window_data.height, colors_.background);
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
+    glm::mat4 viewProjection = coordinates_.projection * coordinates_.view;
+    RenderContext context{ shaders_, colors_, coordinates_.view, Frustum::fromMatrix(viewProjection),
+                           0.5f * coordinates_.projection[1][1] * window_data.height, &shading_lod_ };
+    shading_lod_.beginFrame();
+    culler_.beginFrame(viewProjection, colors_.culling == GPU_CULLING);
+    for (IDrawable* drawable : drawables_)
+        drawable->Cull(culler_, context);
+    culler_.finishCulling();
+
+    for (IDrawable* drawable : drawables_)
+        drawable->Submit(render_queue_, context);
+    render_queue_.flush(colors_.depthPrepass);
+    post_process_.resolve(colors_.culling == GPU_CULLING);
+    culler_.buildDepthPyramid(window_data.width, window_data.height);
+    post_process_.present(colors_.bloomLevels);
+    scene_buffer_.endFrame();
+    light_clusters_.endFrame();
 }
 
 void MainApp::updateCamera()
@@ -143,57 +208,31 @@ void MainApp::updateCamera()
 
 void MainApp::updateShaders()
 {
-    basicShaderUpdate(shaders_.spaceshipShader);
-    basicShaderUpdate(shaders_.sphereShader);
-    basicShaderUpdate(shaders_.asteroidShader);
+    SceneBlock& scene = scene_buffer_.block;
+    scene.projection = coordinates_.projection;
+    scene.view = coordinates_.view;
+    scene.fog_density = fog_.density;
+    scene.skyColor = colors_.background;
+    scene.viewPos = camera_.Position;
 
-    basicShaderUpdate(shaders_.spaceshipShader_g);
-    basicShaderUpdate(shaders_.sphereShader_g);
-    basicShaderUpdate(shaders_.asteroidShader_g);
-}
-
-void MainApp::basicShaderUpdate(Shader& s)
-{
-    s.use();
-    s.setMat4("projection", coordinates_.projection);
-    s.setMat4("view", coordinates_.view);
-    s.setFloat("fog_density", fog_.density);
-    s.setVec3("skyColor", colors_.background);
-    s.setVec3("viewPos", camera_.Position);
-    s.setBool("blinn", colors_.blinn);
-
-    PointLight* lightPoints = planets_.getLightPoints();
-    int count = PlanetsController::lightSpotsCount;
-    for(int i=0; i<count; ++i)
-    {
-        std::string prefix = "pointLights[" + std::to_string(i) + "].";
-        s.setVec3(prefix+"position", lightPoints[i].position);
-        s.setVec3(prefix+"ambient", lightPoints[i].ambient);
-        s.setVec3(prefix+"diffuse", lightPoints[i].diffuse);
-        s.setVec3(prefix+"specular", lightPoints[i].specular);
-        s.setFloat(prefix+"constant", lightPoints[i].constant);
-        s.setFloat(prefix+"linear", lightPoints[i].linear);
-        s.setFloat(prefix+"quadratic", lightPoints[i].quadratic);
-    }
+    light_clusters_.build(planets_.getLights(), planets_.getOccluders(), coordinates_.view, coordinates_.projection,
+                          scene.clusterGrid, scene.clusterDepth);
+    light_clusters_.upload();
+    static_assert(PlanetsController::planetsCount <= LightingCache::MaxTiles, "every planet needs a lighting tile");
+    if (colors_.lightingCache)
+        lighting_cache_.update(planets_.getCachedSpheres(), planets_.getLights());
 
-    CasterLight& caster = spaceship_.getCasterLight();
-    std::string prefix = "casterLight.";
-    s.setVec3(prefix + "position", caster.position);
-    s.setVec3(prefix + "direction", caster.direction);
-    s.setFloat(prefix + "cutOff", glm::cos(glm::radians(caster.cutOff)));
-    s.setFloat(prefix + "outerCutOff", glm::cos(glm::radians(caster.outerCutOff)));
-    s.setVec3(prefix + "ambient", caster.ambient);
-    s.setVec3(prefix + "diffuse", caster.diffuse);
-    s.setVec3(prefix + "specular", caster.specular);
-    s.setFloat(prefix + "constant", caster.constant);
-    s.setFloat(prefix + "linear", caster.linear);
-    s.setFloat(prefix + "quadratic", caster.quadratic);
-
-    prefix = "directionalLight.";
-    s.setVec3(prefix + "direction", colors_.sun_direction);
-    s.setVec3(prefix + "ambient", colors_.ambient_strength * colors_.background);
-    s.setVec3(prefix + "diffuse", colors_.diffuse_strength * colors_.background);
-    s.setVec3(prefix + "specular", colors_.specular_strength * colors_.background);
+    const CasterLight& casterLight = spaceship_.getCasterLight();
+    scene_buffer_.setCasterLight(casterLight);
+    caster_shadow_.setLight(casterLight);
+    scene.casterShadow = caster_shadow_.getShadowMatrix();
+    scene_buffer_.setView(SceneUniformBuffer::CASTER_SHADOW_VIEW, caster_shadow_.getProjection(), caster_shadow_.getView(),
+                          caster_shadow_.getPosition());
+    scene_buffer_.setDirectionalLight(colors_.sun_direction,
+                                      colors_.ambient_strength * colors_.background,
+                                      colors_.diffuse_strength * colors_.background,
+                                      colors_.specular_strength * colors_.background);
+    scene_buffer_.upload();
 }
 
 
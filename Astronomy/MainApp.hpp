@@ -10,11 +10,22 @@
 #include "SpaceshipController.hpp"
 #include "AsteroidsController.hpp"
 #include "PlanetsController.hpp"
+#include "SceneUniformBuffer.hpp"
+#include "ShaderCompiler.hpp"
+#include "ShadersPack.hpp"
+#include "GLState.hpp"
+#include "RenderQueue.hpp"
+#include "Culling.hpp"
+#include "LightClusters.hpp"
+#include "ShadowMap.hpp"
+#include "ShadingLod.hpp"
+#include "LightingCache.hpp"
+#include "PostProcess.hpp"
 
 class MainApp
 {
 public:
-    MainApp(GLFWwindow* window);
+    MainApp(GLFWwindow* window, bool starField = false);
     void mainLoop();
 
     static WindowData window_data;
@@ -26,7 +37,17 @@ private:
     PlanetsController planets_;
     SpaceshipController spaceship_;
 
+    ShaderCompiler shader_compiler_;
     ShadersPack shaders_;
+    SceneUniformBuffer scene_buffer_;
+    LightClusters light_clusters_;
+    ShadowMap caster_shadow_;
+    LightingCache lighting_cache_;
+    RenderQueue render_queue_;
+    GpuCuller culler_;
+    ShadingLod shading_lod_;
+    PostProcess post_process_;
+    std::vector<IDrawable*> drawables_;
 
     static ColoringData colors_;
     static FogData fog_;
@@ -42,7 +63,9 @@ private:
     void update();
     void updateCamera();
     void updateShaders();
-    void basicShaderUpdate(Shader& s);
+    ShaderPermutation::Object sphereObject();
+    void renderShadows();
+    void render();
 
     static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
     static void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
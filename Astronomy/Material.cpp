@@ -0,0 +1,56 @@
+#include "Material.hpp"
+#include "GLState.hpp"
+#include <iostream>
+
+unsigned int Material::nextId_ = 0;
+
+namespace
+{
+    const char* const SamplerPrefixes[Material::SLOT_COUNT] = {
+        "texture_diffuse",
+        "texture_specular",
+        "texture_normal",
+        "texture_height"
+    };
+}
+
+Material::Material()
+    :id_(nextId_++), counts_()
+{
+}
+
+void Material::addTexture(TextureSlot slot, GLuint texture)
+{
+    if (counts_[slot] >= UnitsPerSlot)
+    {
+        std::cout << "WARNING::MATERIAL::TOO_MANY_TEXTURES: " << SamplerPrefixes[slot] << std::endl;
+        return;
+    }
+    bindings_.emplace_back(unitFor(slot, counts_[slot]++), texture);
+}
+
+void Material::bind() const
+{
+    for (auto& binding : bindings_)
+        GLState::bindTexture(binding.first, GL_TEXTURE_2D, binding.second);
+}
+
+unsigned int Material::getId() const
+{
+    return id_;
+}
+
+GLuint Material::unitFor(TextureSlot slot, GLuint index)
+{
+    return static_cast<GLuint>(slot) * UnitsPerSlot + index;
+}
+
+std::vector<std::pair<std::string, GLint>> Material::samplerBindings()
+{
+    std::vector<std::pair<std::string, GLint>> bindings;
+    for (int slot = 0; slot < SLOT_COUNT; ++slot)
+        for (GLuint i = 0; i < UnitsPerSlot; ++i)
+            bindings.emplace_back(SamplerPrefixes[slot] + std::to_string(i + 1),
+                                  static_cast<GLint>(unitFor(static_cast<TextureSlot>(slot), i)));
+    return bindings;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Material
+{
+public:
+    enum TextureSlot
+    {
+        DIFFUSE = 0,
+        SPECULAR = 1,
+        NORMAL = 2,
+        HEIGHT = 3,
+        SLOT_COUNT
+    };
+
+    static const GLuint UnitsPerSlot = 4;
+
+    Material();
+
+    void addTexture(TextureSlot slot, GLuint texture);
+    void bind() const;
+    unsigned int getId() const;
+
+    static GLuint unitFor(TextureSlot slot, GLuint index);
+    static std::vector<std::pair<std::string, GLint>> samplerBindings();
+
+private:
+    unsigned int id_;
+    GLuint counts_[SLOT_COUNT];
+    std::vector<std::pair<GLuint, GLuint>> bindings_;
+
+    static unsigned int nextId_;
+};
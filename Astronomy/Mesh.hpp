@@ -5,6 +5,10 @@
 #include <string>
 #include <vector>
 #include "Shader.hpp"
+#include "VertexFormat.hpp"
+#include "Material.hpp"
+#include "GpuMemory.hpp"
+#include <memory>
 
 #define MAX_BONE_INFLUENCE 4
 
@@ -18,6 +22,72 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+template<>
+struct VertexLayout<Vertex>
+{
+    static constexpr std::array<VertexAttribute, 7> attributes()
+    {
+        return {{
+            VERTEX_ATTRIBUTE(Vertex, Position, 0),
+            VERTEX_ATTRIBUTE(Vertex, Normal, 1),
+            VERTEX_ATTRIBUTE(Vertex, TexCoords, 2),
+            VERTEX_ATTRIBUTE(Vertex, Tangent, 3),
+            VERTEX_ATTRIBUTE(Vertex, Bitangent, 4),
+            VERTEX_ATTRIBUTE(Vertex, m_BoneIDs, 5),
+            VERTEX_ATTRIBUTE(Vertex, m_Weights, 6),
+        }};
+    }
+};
+
+struct PackedVertex {
+    glm::vec3 Position;
+    PackedSnorm Normal;
+    PackedSnorm Tangent;
+    PackedHalf2 TexCoords;
+};
+
+struct SkinnedPackedVertex {
+    glm::vec3 Position;
+    PackedSnorm Normal;
+    PackedSnorm Tangent;
+    PackedHalf2 TexCoords;
+    BoneIndices BoneIDs;
+    BoneWeights Weights;
+};
+
+template<>
+struct VertexLayout<PackedVertex>
+{
+    static constexpr std::array<VertexAttribute, 4> attributes()
+    {
+        return {{
+            VERTEX_ATTRIBUTE(PackedVertex, Position, 0),
+            VERTEX_ATTRIBUTE(PackedVertex, Normal, 1),
+            VERTEX_ATTRIBUTE(PackedVertex, TexCoords, 2),
+            VERTEX_ATTRIBUTE(PackedVertex, Tangent, 3),
+        }};
+    }
+};
+
+template<>
+struct VertexLayout<SkinnedPackedVertex>
+{
+    static constexpr std::array<VertexAttribute, 6> attributes()
+    {
+        return {{
+            VERTEX_ATTRIBUTE(SkinnedPackedVertex, Position, 0),
+            VERTEX_ATTRIBUTE(SkinnedPackedVertex, Normal, 1),
+            VERTEX_ATTRIBUTE(SkinnedPackedVertex, TexCoords, 2),
+            VERTEX_ATTRIBUTE(SkinnedPackedVertex, Tangent, 3),
+            VERTEX_ATTRIBUTE(SkinnedPackedVertex, BoneIDs, 5),
+            VERTEX_ATTRIBUTE(SkinnedPackedVertex, Weights, 6),
+        }};
+    }
+};
+
+static_assert(sizeof(PackedVertex) == 24, "PackedVertex must stay tightly packed");
+static_assert(sizeof(SkinnedPackedVertex) == 36, "SkinnedPackedVertex must stay tightly packed");
+
 struct Texture {
     unsigned int id;
     std::string type;
@@ -26,16 +96,46 @@ struct Texture {
 
 class Mesh {
 public:
-    std::vector<Vertex>       vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture>      textures;
+    enum Format
+    {
+        FULL,
+        PACKED,
+        SKINNED_PACKED
+    };
+
+    std::shared_ptr<Material> material;
     unsigned int VAO;
+    Format format;
+    Geometry geometry;
+    glm::vec3 boundsMin, boundsMax;
 
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-    void Draw(Shader& shader);
+    template<typename V>
+    Mesh(const std::vector<V>& vertices, const std::vector<unsigned int>& indices, std::shared_ptr<Material> material)
+        : material(std::move(material)), VAO(GeometryMemory::sharedVertexArray<V>()), format(formatOf<V>()),
+          boundsMin(0.0f), boundsMax(0.0f)
+    {
+        if (!GeometryMemory::upload(vertices, indices, geometry))
+            std::cout << "ERROR::MESH::GEOMETRY_NOT_UPLOADED " << vertices.size() << " vertices" << std::endl;
+        if (!vertices.empty())
+            boundsMin = boundsMax = vertices[0].Position;
+        for (auto& vertex : vertices)
+        {
+            boundsMin = glm::min(boundsMin, vertex.Position);
+            boundsMax = glm::max(boundsMax, vertex.Position);
+        }
+    }
+
+    Mesh(Mesh&& other) noexcept;
+    Mesh& operator=(Mesh&& other) noexcept;
+    ~Mesh();
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
 
 private:
-    unsigned int VBO, EBO;
-    
-    void setupMesh();
-};
\ No newline at end of file
+    template<typename V> static Format formatOf();
+};
+
+template<> inline Mesh::Format Mesh::formatOf<Vertex>() { return FULL; }
+template<> inline Mesh::Format Mesh::formatOf<PackedVertex>() { return PACKED; }
+template<> inline Mesh::Format Mesh::formatOf<SkinnedPackedVertex>() { return SKINNED_PACKED; }
@@ -0,0 +1,209 @@
+#include "MeshOptimizer.hpp"
+#include "VertexFormat.hpp"
+#include <iostream>
+
+namespace
+{
+    class FifoCache
+    {
+    public:
+        explicit FifoCache(size_t vertexCount)
+            :stamps_(vertexCount, 0)
+        {
+        }
+
+        // returns true on a miss
+        bool touch(unsigned int vertex)
+        {
+            if (stamps_[vertex] != 0 && misses_ - stamps_[vertex] < MeshOptimizer::CacheSize)
+                return false;
+            stamps_[vertex] = ++misses_;
+            return true;
+        }
+
+        void flush()
+        {
+            misses_ += MeshOptimizer::CacheSize;
+        }
+
+        unsigned int misses() const { return misses_; }
+
+    private:
+        std::vector<unsigned int> stamps_;
+        unsigned int misses_ = 0;
+    };
+}
+
+IndexStats MeshOptimizer::analyze(const std::vector<unsigned int>& indices, size_t vertexCount)
+{
+    FifoCache cache(vertexCount);
+    for (unsigned int index : indices)
+        cache.touch(index);
+
+    size_t triangles = indices.size() / 3;
+    return IndexStats{
+        triangles ? static_cast<float>(cache.misses()) / triangles : 0.0f,
+        vertexCount ? static_cast<float>(cache.misses()) / vertexCount : 0.0f
+    };
+}
+
+// Tipsify (Sander, Nehab and Barczak 2007)
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    std::vector<unsigned int> live(vertexCount, 0);
+    for (unsigned int index : indices)
+        ++live[index];
+
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+        adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd, candidates, result;
+    result.reserve(indices.size());
+    unsigned int time = CacheSize + 1;
+    size_t cursor = 0;
+
+    int vertex = indices.empty() ? -1 : static_cast<int>(indices[0]);
+    while (vertex >= 0)
+    {
+        candidates.clear();
+        for (unsigned int i = offsets[vertex]; i < offsets[vertex + 1]; ++i)
+        {
+            unsigned int triangle = adjacency[i];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+            for (int k = 0; k < 3; ++k)
+            {
+                unsigned int v = indices[3 * triangle + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cacheTime[v] > CacheSize)
+                    cacheTime[v] = time++;
+            }
+        }
+
+        vertex = -1;
+        int bestPriority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= CacheSize)
+                priority = static_cast<int>(time - cacheTime[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                vertex = static_cast<int>(v);
+            }
+        }
+
+        while (vertex < 0 && !deadEnd.empty())
+        {
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                vertex = static_cast<int>(v);
+        }
+
+        while (vertex < 0 && cursor < vertexCount)
+        {
+            if (live[cursor] > 0)
+                vertex = static_cast<int>(cursor);
+            ++cursor;
+        }
+    }
+
+    indices.swap(result);
+}
+
+// Splits the cache-ordered triangles into clusters and draws outward-facing clusters first (Sander et al. 2007)
+void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    FifoCache cache(positions.size());
+    std::vector<unsigned int> triangleMisses(triangleCount, 0);
+    for (size_t t = 0; t < triangleCount; ++t)
+        for (int k = 0; k < 3; ++k)
+            triangleMisses[t] += cache.touch(indices[3 * t + k]) ? 1 : 0;
+    float meshAcmr = static_cast<float>(cache.misses()) / triangleCount;
+
+    // a cluster may end once its cold-cache ACMR is within threshold of the whole mesh
+    std::vector<size_t> clusters(1, 0);
+    FifoCache clusterCache(positions.size());
+    unsigned int clusterMisses = 0;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        size_t clusterSize = t - clusters.back();
+        if (clusterSize > 0 && (triangleMisses[t] == 3 || clusterMisses <= threshold * meshAcmr * clusterSize))
+        {
+            clusters.push_back(t);
+            clusterCache.flush();
+            clusterMisses = 0;
+        }
+        for (int k = 0; k < 3; ++k)
+            clusterMisses += clusterCache.touch(indices[3 * t + k]) ? 1 : 0;
+    }
+    clusters.push_back(triangleCount);
+
+    glm::vec3 meshCentroid(0.0f);
+    for (unsigned int index : indices)
+        meshCentroid += positions[index];
+    meshCentroid /= static_cast<float>(indices.size());
+
+    size_t clusterCount = clusters.size() - 1;
+    std::vector<float> sortKeys(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            const glm::vec3& a = positions[indices[3 * t]];
+            const glm::vec3& b = positions[indices[3 * t + 1]];
+            const glm::vec3& p = positions[indices[3 * t + 2]];
+            glm::vec3 cross = glm::cross(b - a, p - a);
+            float triangleArea = glm::length(cross);
+            centroid += (a + b + p) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        float normalLength = glm::length(normal);
+        if (area > 0.0f && normalLength > 0.0f)
+            sortKeys[c] = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c : order)
+        result.insert(result.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * clusters[c + 1]);
+    indices.swap(result);
+}
+
+void MeshOptimizer::report(const std::string& name, size_t triangles, size_t verticesBefore, size_t verticesAfter,
+                           const IndexStats& before, const IndexStats& after)
+{
+    std::cout << "MESH_OPTIMIZER::" << name << ": " << triangles << " triangles, "
+              << verticesBefore << " -> " << verticesAfter << " vertices, "
+              << "ACMR " << before.acmr << " -> " << after.acmr << ", "
+              << "ATVR " << before.atvr << " -> " << after.atvr << ", "
+              << (verticesAfter <= MaxShortIndexVertices ? 16 : 32) << "-bit indices" << std::endl;
+}
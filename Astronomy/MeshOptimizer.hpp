@@ -0,0 +1,88 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct IndexStats
+{
+    float acmr;
+    float atvr;
+};
+
+// Load-time index buffer optimisation, simulated against a FIFO post-transform cache of CacheSize entries.
+class MeshOptimizer
+{
+public:
+    static const unsigned int CacheSize = 16;
+
+    static IndexStats analyze(const std::vector<unsigned int>& indices, size_t vertexCount);
+    static void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+    static void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, float threshold = 1.05f);
+
+    template<typename V>
+    static void weldVertices(const std::vector<V>& vertices, std::vector<unsigned int>& indices)
+    {
+        std::vector<unsigned int> order(vertices.size());
+        for (unsigned int i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+            int compare = std::memcmp(&vertices[a], &vertices[b], sizeof(V));
+            return compare < 0 || (compare == 0 && a < b);
+        });
+
+        std::vector<unsigned int> remap(vertices.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            bool duplicate = i > 0 && std::memcmp(&vertices[order[i]], &vertices[order[i - 1]], sizeof(V)) == 0;
+            remap[order[i]] = duplicate ? remap[order[i - 1]] : order[i];
+        }
+        for (auto& index : indices)
+            index = remap[index];
+    }
+
+    template<typename V>
+    static void optimizeVertexFetch(std::vector<V>& vertices, std::vector<unsigned int>& indices)
+    {
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<V> fetched;
+        fetched.reserve(vertices.size());
+        for (auto& index : indices)
+        {
+            if (remap[index] == unused)
+            {
+                remap[index] = static_cast<unsigned int>(fetched.size());
+                fetched.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(fetched);
+    }
+
+    template<typename V>
+    static void optimize(const std::string& name, std::vector<V>& vertices, std::vector<unsigned int>& indices)
+    {
+        if (indices.empty() || indices.size() % 3 != 0)
+            return;
+
+        size_t vertexCount = vertices.size();
+        IndexStats before = analyze(indices, vertexCount);
+
+        weldVertices(vertices, indices);
+        optimizeVertexCache(indices, vertices.size());
+        std::vector<glm::vec3> positions;
+        positions.reserve(vertices.size());
+        for (auto& vertex : vertices)
+            positions.push_back(vertex.Position);
+        optimizeOverdraw(indices, positions);
+        optimizeVertexFetch(vertices, indices);
+
+        report(name, indices.size() / 3, vertexCount, vertices.size(), before, analyze(indices, vertices.size()));
+    }
+
+private:
+    static void report(const std::string& name, size_t triangles, size_t verticesBefore, size_t verticesAfter,
+                       const IndexStats& before, const IndexStats& after);
+};
@@ -5,6 +5,9 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include <assimp/postprocess.h>
+#include "GLState.hpp"
+#include "MeshOptimizer.hpp"
+#include <algorithm>
 
 unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma=false)
 {
@@ -26,7 +29,7 @@ unsigned int TextureFromFile(const char* path, const std::string& directory, boo
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::bindTexture(0, GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -46,14 +49,14 @@ unsigned int TextureFromFile(const char* path, const std::string& directory, boo
     return textureID;
 }
 
-Model::Model(std::string const& path, bool gamma) : gammaCorrection(gamma)
+Model::Model(std::string const& path, bool gamma, bool packVertices) : gammaCorrection(gamma), packVertices(packVertices)
 {
     loadModel(path);
 }
 
 glm::vec3 Model::getCenter()
 {
-    if (!meshes.empty() && !meshes[0].vertices.empty()) {
+    if (!meshes.empty()) {
         auto v = getMinMax();
         return (v.first + v.second)/=2;
     }
@@ -62,28 +65,14 @@ glm::vec3 Model::getCenter()
 
 std::pair<glm::vec3, glm::vec3> Model::getMinMax()
 {
-    if (!meshes.empty() && !meshes[0].vertices.empty()) {
-        glm::vec3 minValues = meshes[0].vertices[0].Position;
-        glm::vec3 maxValues = meshes[0].vertices[0].Position;
+    if (!meshes.empty()) {
+        glm::vec3 minValues = meshes[0].boundsMin;
+        glm::vec3 maxValues = meshes[0].boundsMax;
 
         for (auto& mesh : meshes)
         {
-            for (auto v : mesh.vertices)
-            {
-                if (v.Position.x < minValues.x)
-                    minValues.x = v.Position.x;
-                if (v.Position.y < minValues.y)
-                    minValues.y = v.Position.y;
-                if (v.Position.z < minValues.z)
-                    minValues.z = v.Position.z;
-
-                if (v.Position.x > maxValues.x)
-                    maxValues.x = v.Position.x;
-                if (v.Position.y > maxValues.y)
-                    maxValues.y = v.Position.y;
-                if (v.Position.z > maxValues.z)
-                    maxValues.z = v.Position.z;
-            }
+            minValues = glm::min(minValues, mesh.boundsMin);
+            maxValues = glm::max(maxValues, mesh.boundsMax);
         }
 
         return std::make_pair(minValues, maxValues);
@@ -91,12 +80,52 @@ std::pair<glm::vec3, glm::vec3> Model::getMinMax()
     return {};
 }
 
+void Model::Submit(RenderQueue& queue, Shader& shader, Shader& depthShader, const glm::mat4& transform, float depth,
+                   const Frustum* frustum)
+{
+    visibleMeshes_.clear();
+    if (frustum)
+    {
+        float scale = glm::max(glm::length(glm::vec3(transform[0])),
+                               glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+        worldBounds_.clear();
+        for (auto& mesh : meshes)
+        {
+            glm::vec3 center = glm::vec3(transform * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+            worldBounds_.add(glm::vec4(center, 0.5f * glm::length(mesh.boundsMax - mesh.boundsMin) * scale));
+        }
+        FrustumCuller::cull(*frustum, worldBounds_, visibleMeshes_);
+        if (visibleMeshes_.empty())
+            return;
+    }
+    else
+    {
+        for (uint32_t i = 0; i < meshes.size(); i++)
+            visibleMeshes_.push_back(i);
+    }
 
+    GLuint baseInstance = 0;
+    ObjectInstance* instance = queue.allocateInstances(1, baseInstance);
+    if (!instance)
+        return;
+    *instance = ObjectInstance{ transform, glm::vec3(1.0f) };
 
-void Model::Draw(Shader& shader)
-{
-    for (unsigned int i = 0; i < meshes.size(); i++)
-        meshes[i].Draw(shader);
+    for (uint32_t index : visibleMeshes_)
+    {
+        const Mesh& mesh = meshes[index];
+        if (mesh.geometry.indexCount == 0)
+            continue;
+        DrawPacket packet = DrawPacket::elements(mesh.VAO, mesh.geometry.indexCount, 1, baseInstance);
+        packet.indexType = mesh.geometry.indexType;
+        packet.first = static_cast<GLint>(mesh.geometry.firstIndex);
+        packet.baseVertex = mesh.geometry.baseVertex;
+        packet.shader = &shader;
+        packet.depthShader = &depthShader;
+        packet.material = mesh.material.get();
+        packet.depth = depth;
+        packet.streamed = true;
+        queue.submit(packet);
+    }
 }
 
 void Model::loadModel(std::string const& path)
@@ -109,7 +138,13 @@ void Model::loadModel(std::string const& path)
         return;
     }
     directory = path.substr(0, path.find_last_of('/'));
+    for (unsigned int i = 0; i < scene->mNumMaterials; i++)
+        materials.push_back(loadMaterial(scene->mMaterials[i]));
     processNode(scene->mRootNode, scene);
+
+    std::stable_sort(meshes.begin(), meshes.end(), [](const Mesh& a, const Mesh& b) {
+        return a.material->getId() < b.material->getId();
+    });
 }
 
 void Model::processNode(aiNode* node, const aiScene* scene)
@@ -117,55 +152,120 @@ void Model::processNode(aiNode* node, const aiScene* scene)
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        meshes.push_back(processMesh(mesh));
     }
 
     for (unsigned int i = 0; i < node->mNumChildren; i++)
         processNode(node->mChildren[i], scene);
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+static glm::vec3 safeNormalize(const glm::vec3& v)
 {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+    float length = glm::length(v);
+    return length > 0.0f ? v / length : glm::vec3(0.0f);
+}
 
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+static Vertex readVertex(const aiMesh* mesh, unsigned int i)
+{
+    Vertex vertex = {};
+    glm::vec3 vector; 
+    vector.x = mesh->mVertices[i].x;
+    vector.y = mesh->mVertices[i].y;
+    vector.z = mesh->mVertices[i].z;
+    vertex.Position = vector;
+    if (mesh->HasNormals())
     {
-        Vertex vertex;
-        glm::vec3 vector; 
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.Position = vector;
-        if (mesh->HasNormals())
-        {
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.Normal = vector;
-        }
+        vector.x = mesh->mNormals[i].x;
+        vector.y = mesh->mNormals[i].y;
+        vector.z = mesh->mNormals[i].z;
+        vertex.Normal = vector;
+    }
+
+    if (mesh->mTextureCoords[0])
+    {
+        glm::vec2 vec;
+        vec.x = mesh->mTextureCoords[0][i].x;
+        vec.y = mesh->mTextureCoords[0][i].y;
+        vertex.TexCoords = vec;
+        vector.x = mesh->mTangents[i].x;
+        vector.y = mesh->mTangents[i].y;
+        vector.z = mesh->mTangents[i].z;
+        vertex.Tangent = vector;
+        vector.x = mesh->mBitangents[i].x;
+        vector.y = mesh->mBitangents[i].y;
+        vector.z = mesh->mBitangents[i].z;
+        vertex.Bitangent = vector;
+    }
+    else
+        vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+
+    return vertex;
+}
+
+template<typename V>
+static V packVertex(const Vertex& vertex)
+{
+    V packed = {};
+    packed.Position = vertex.Position;
+    packed.Normal = packSnorm(glm::vec4(safeNormalize(vertex.Normal), 0.0f));
+    float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+    packed.Tangent = packSnorm(glm::vec4(safeNormalize(vertex.Tangent), handedness));
+    packed.TexCoords = packHalf(vertex.TexCoords);
+    return packed;
+}
+
+template<typename V>
+static std::vector<V> readPackedVertices(const aiMesh* mesh)
+{
+    std::vector<V> vertices;
+    vertices.reserve(mesh->mNumVertices);
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        vertices.push_back(packVertex<V>(readVertex(mesh, i)));
+    return vertices;
+}
 
-        if (mesh->mTextureCoords[0])
+static void packBoneWeights(const aiMesh* mesh, std::vector<SkinnedPackedVertex>& vertices)
+{
+    std::vector<glm::vec4> weights(vertices.size(), glm::vec4(0.0f));
+    for (unsigned int b = 0; b < mesh->mNumBones; b++)
+    {
+        const aiBone* bone = mesh->mBones[b];
+        for (unsigned int w = 0; w < bone->mNumWeights; w++)
         {
-            glm::vec2 vec;
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.TexCoords = vec;
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.Tangent = vector;
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.Bitangent = vector;
+            unsigned int id = bone->mWeights[w].mVertexId;
+            int slot = 0;
+            for (int k = 1; k < MAX_BONE_INFLUENCE; k++)
+                if (weights[id][k] < weights[id][slot])
+                    slot = k;
+            if (bone->mWeights[w].mWeight > weights[id][slot])
+            {
+                weights[id][slot] = bone->mWeights[w].mWeight;
+                vertices[id].BoneIDs.id[slot] = static_cast<uint16_t>(b);
+            }
         }
-        else
-            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+    }
 
-        vertices.push_back(vertex);
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        float sum = weights[i].x + weights[i].y + weights[i].z + weights[i].w;
+        if (sum > 0.0f)
+            weights[i] /= sum;
+        for (int k = 0; k < MAX_BONE_INFLUENCE; k++)
+            vertices[i].Weights.weight[k] = static_cast<uint8_t>(weights[i][k] * 255.0f + 0.5f);
     }
+}
+
+template<typename V>
+static Mesh optimizedMesh(const aiMesh* mesh, std::vector<V> vertices, std::vector<unsigned int> indices, std::shared_ptr<Material> material)
+{
+    MeshOptimizer::optimize(mesh->mName.length ? mesh->mName.C_Str() : "mesh", vertices, indices);
+    return Mesh(vertices, indices, material);
+}
+
+Mesh Model::processMesh(aiMesh* mesh)
+{
+    std::vector<unsigned int> indices;
+    std::shared_ptr<Material> material = materials[mesh->mMaterialIndex];
 
     for (unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
@@ -174,17 +274,37 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
             indices.push_back(face.mIndices[j]);
     }
 
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-    std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-    std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-    std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-    std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+    if (!packVertices)
+    {
+        std::vector<Vertex> vertices;
+        vertices.reserve(mesh->mNumVertices);
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+            vertices.push_back(readVertex(mesh, i));
+        return optimizedMesh(mesh, vertices, indices, material);
+    }
+
+    if (mesh->HasBones())
+    {
+        std::vector<SkinnedPackedVertex> vertices = readPackedVertices<SkinnedPackedVertex>(mesh);
+        packBoneWeights(mesh, vertices);
+        return optimizedMesh(mesh, vertices, indices, material);
+    }
 
-    return Mesh(vertices, indices, textures);
+    return optimizedMesh(mesh, readPackedVertices<PackedVertex>(mesh), indices, material);
+}
+
+std::shared_ptr<Material> Model::loadMaterial(aiMaterial* mat)
+{
+    std::shared_ptr<Material> material = std::make_shared<Material>();
+    for (auto& texture : loadMaterialTextures(mat, aiTextureType_DIFFUSE, "texture_diffuse"))
+        material->addTexture(Material::DIFFUSE, texture.id);
+    for (auto& texture : loadMaterialTextures(mat, aiTextureType_SPECULAR, "texture_specular"))
+        material->addTexture(Material::SPECULAR, texture.id);
+    for (auto& texture : loadMaterialTextures(mat, aiTextureType_HEIGHT, "texture_normal"))
+        material->addTexture(Material::NORMAL, texture.id);
+    for (auto& texture : loadMaterialTextures(mat, aiTextureType_AMBIENT, "texture_height"))
+        material->addTexture(Material::HEIGHT, texture.id);
+    return material;
 }
 
 std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName)
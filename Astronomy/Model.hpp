@@ -4,6 +4,7 @@
 #include <assimp/scene.h>
 #include "Mesh.hpp"
 #include "Shader.hpp"
+#include "RenderQueue.hpp"
 #include <string>
 #include <sstream>
 #include <vector>
@@ -13,18 +14,25 @@ class Model
 public:
     std::vector<Texture> textures_loaded;
     std::vector<Mesh> meshes;
+    std::vector<std::shared_ptr<Material>> materials;
     std::string directory;
     bool gammaCorrection;
+    bool packVertices;
 
-    Model(std::string const& path, bool gamma = false);
-    void Draw(Shader& shader);
+    Model(std::string const& path, bool gamma = false, bool packVertices = true);
+    void Submit(RenderQueue& queue, Shader& shader, Shader& depthShader, const glm::mat4& transform, float depth,
+                const Frustum* frustum = nullptr);
     glm::vec3 getCenter();
     std::pair<glm::vec3, glm::vec3> getMinMax();
 
 private:
+    SphereSet worldBounds_;
+    std::vector<uint32_t> visibleMeshes_;
+
     void loadModel(std::string const& path);
     void processNode(aiNode* node, const aiScene* scene);
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    Mesh processMesh(aiMesh* mesh);
+    std::shared_ptr<Material> loadMaterial(aiMaterial* mat);
     std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
 };
\ No newline at end of file
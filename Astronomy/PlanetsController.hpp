@@ -3,13 +3,17 @@
 #include <vector>
 #include "IDrawable.hpp"
 #include "DataContainers.hpp"
+#include "VertexFormat.hpp"
+#include "MeshOptimizer.hpp"
+#include "GpuMemory.hpp"
 #define M_PI 3.14159265358979323846
 #define SEED 1
 
 class Sphere
 {
 public:
-    Sphere()
+    Sphere(int sectors, int stacks)
+        :sectors(sectors), stacks(stacks)
     {
         generate();
         divideTriangles();
@@ -21,11 +25,11 @@ public:
     std::vector<int> indices;
     std::vector<int> lineIndices;
 
-    std::vector<float> trianglesData;
+    std::vector<PositionNormalVertex> trianglesData;
 
 private:
-    static const int sectors = 32;
-    static const int stacks = 32;
+    int sectors;
+    int stacks;
 
     void generate()
     {
@@ -99,16 +103,21 @@ private:
     {
         for(int i=0; i<vertices.size(); i+=3)
         {
-            trianglesData.push_back(vertices[i]);
-            trianglesData.push_back(vertices[i+1]);
-            trianglesData.push_back(vertices[i+2]);
-            trianglesData.push_back(normals[i]);
-            trianglesData.push_back(normals[i + 1]);
-            trianglesData.push_back(normals[i + 2]);
+            trianglesData.push_back({
+                glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]),
+                glm::vec3(normals[i], normals[i + 1], normals[i + 2])
+            });
         }
     }
 };
 
+struct SphereLod
+{
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+};
+
 struct PlanetData
 {
     glm::vec3 postion;
@@ -116,85 +125,404 @@ struct PlanetData
     float scale_factor;
 };
 
+struct SphereInstance
+{
+    glm::vec3 center;
+    float radius;
+    glm::vec3 color;
+    int lightingTile = -1;
+};
+
+template<>
+struct VertexLayout<SphereInstance>
+{
+    static constexpr std::array<VertexAttribute, 4> attributes()
+    {
+        return {{
+            VERTEX_ATTRIBUTE(SphereInstance, center, 8),
+            VERTEX_ATTRIBUTE(SphereInstance, radius, 9),
+            VERTEX_ATTRIBUTE(SphereInstance, color, 12),
+            VERTEX_ATTRIBUTE(SphereInstance, lightingTile, 13),
+        }};
+    }
+};
+
 class PlanetsController :public IDrawable
 {
 public:
-    PlanetsController()
+    explicit PlanetsController(bool starField = false)
+        :starsCount_(starField ? starFieldCount : sceneStarsCount)
     {
         generate_graphics_data();
         generate_planets();
-        generate_stars();
+        generate_stars(starField);
+        generate_bounds();
+        generate_mesh_instances();
+        generate_impostor_data();
     }
 
     ~PlanetsController()
     {
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
+        GLState::deleteVertexArray(VAO);
+        GeometryMemory::release(lodGeometry_);
+        GLState::deleteBuffer(meshInstanceVBO);
+        GLState::deleteBuffer(visibleMeshInstanceVBO);
+        GLState::deleteBuffer(meshCommands);
+        GLState::deleteVertexArray(impostorVAO);
+        GLState::deleteVertexArray(shadowVAO);
+        GLState::deleteBuffer(quadVBO);
+        GLState::deleteBuffer(instanceVBO);
+        GLState::deleteBuffer(visibleInstanceVBO);
+        GLState::deleteBuffer(impostorCommands);
+        GLState::deleteBuffer(boundsBuffer);
+        GLState::deleteBuffer(meshBoundsBuffer);
     }
 
-    void Draw(Shader& shader) override
+    void Cull(GpuCuller& culler, const RenderContext& context) override
     {
-        glBindVertexArray(VAO);
+        if (!drawImpostors(context))
+            updateLods(context);
 
+        if (context.colors.culling == CPU_CULLING)
+        {
+            FrustumCuller::cull(context.frustum, spheres_, visible_);
+            if (drawImpostors(context))
+                uploadVisible(sphereInstances_, visibleInstanceVBO, impostorCommands, impostorBatches_, false);
+            else
+                uploadVisible(meshInstances_, visibleMeshInstanceVBO, meshCommands, meshBatches_, true);
+            return;
+        }
 
-        shader.setBool("star", true);
+        if (drawImpostors(context))
+            cullBatches(culler, boundsBuffer, impostorBatches_, instanceVBO, sizeof(SphereInstance),
+                        visibleInstanceVBO, impostorCommands, false);
+        else
+            cullBatches(culler, meshBoundsBuffer, meshBatches_, meshInstanceVBO, sizeof(ObjectInstance),
+                        visibleMeshInstanceVBO, meshCommands, true);
+    }
 
-        for (auto& star : stars)
-            DrawPlanet(star, shader);
+    void Submit(RenderQueue& queue, const RenderContext& context) override
+    {
+        if (drawImpostors(context))
+        {
+            Shader& starShader = context.shader(ShaderPermutation::SPHERE_IMPOSTOR, true);
+            Shader& planetShader = context.shader(ShaderPermutation::SPHERE_IMPOSTOR, false, context.colors.lightingCache);
+            Shader& depthShader = context.depthShader(ShaderPermutation::SPHERE_IMPOSTOR);
+            queue.submit(impostorPacket(starShader, depthShader, 0));
+            queue.submit(impostorPacket(planetShader, depthShader, sizeof(DrawArraysIndirectCommand)));
+            return;
+        }
 
-        shader.setBool("star", false);
+        Shader& starShader = context.shader(ShaderPermutation::SPHERE, true);
+        Shader& depthShader = context.depthShader(ShaderPermutation::SPHERE);
+        const GLintptr planetCommands = lodCount * sizeof(DrawElementsIndirectCommand);
+        queue.submit(meshPacket(starShader, depthShader, 0, lodCount));
+        if (!context.colors.shadingLod)
+        {
+            queue.submit(meshPacket(context.shader(ShaderPermutation::SPHERE, false, context.colors.lightingCache), depthShader,
+                                    planetCommands, lodCount));
+            return;
+        }
+        queue.submit(meshPacket(context.lodShader(ShaderPermutation::SPHERE, true, context.colors.lightingCache), depthShader,
+                                planetCommands, gouraudLods));
+        queue.submit(meshPacket(context.lodShader(ShaderPermutation::SPHERE, false, context.colors.lightingCache), depthShader,
+                                planetCommands + gouraudLods * sizeof(DrawElementsIndirectCommand), lodCount - gouraudLods));
+    }
 
-        for (auto& planet : planets)
-            DrawPlanet(planet, shader);
+    // every sphere as an impostor, unculled
+    void SubmitShadow(RenderQueue& queue, const RenderContext& context, ShadowLayer layer) override
+    {
+        if (layer != STATIC_CASTERS)
+            return;
+        DrawPacket packet = DrawPacket::arrays(shadowVAO, GL_TRIANGLE_STRIP, 0, 4, starsCount_ + planetsCount);
+        packet.shader = packet.depthShader = &context.depthShader(ShaderPermutation::SPHERE_IMPOSTOR);
+        queue.submit(packet);
+    }
 
-        glBindVertexArray(0);
+    const std::vector<PointLight>& getLights() const
+    {
+        return lights_;
+    }
+
+    const std::vector<glm::vec4>& getOccluders() const
+    {
+        return bounds_;
     }
 
-    PointLight* getLightPoints()
+    // lit spheres in lighting tile order
+    const std::vector<glm::vec4>& getCachedSpheres() const
     {
-        return lightSpots;
+        return cachedSpheres_;
     }
 
     static const int planetsCount = 64;
-    static const int lightSpotsCount = 2;
-    static Sphere sphere_;
+    // the opt-in star field swaps the two long-range stars for many short-range ones
+    static const int sceneStarsCount = 2;
+    static const int starFieldCount = 128;
+    static const int lodCount = 5;
 private:
-
-    GLuint VBO, EBO, VAO;
+    static constexpr float lodEdgePixels = 6.0f;
+    static constexpr float lodHysteresis = 0.2f;
+    // with shading LOD on, planets in the coarsest LODs (up to ~15 px radius) are lit per vertex;
+    // the LOD's own hysteresis stands in for the shading one
+    static const int gouraudLods = 2;
+
+    const int starsCount_;
+
+    GLuint VAO, meshInstanceVBO, visibleMeshInstanceVBO, meshCommands;
+    GLuint impostorVAO, shadowVAO, quadVBO, instanceVBO, visibleInstanceVBO, impostorCommands;
+    GLuint boundsBuffer, meshBoundsBuffer;
+    Geometry lodGeometry_;
+    SphereLod lods_[lodCount];
+    std::vector<int> instanceLods_;
+    std::vector<glm::vec4> bounds_;
+    std::vector<glm::vec4> cachedSpheres_;
+    std::vector<ObjectInstance> meshInstances_;
+    std::vector<SphereInstance> sphereInstances_;
+    std::vector<DrawElementsIndirectCommand> meshBatches_;
+    std::vector<DrawArraysIndirectCommand> impostorBatches_;
+    SphereSet spheres_;
+    std::vector<uint32_t> visible_;
     PlanetData planets[planetsCount];
-    PlanetData stars[lightSpotsCount];
-    PointLight lightSpots[lightSpotsCount];
+    std::vector<PlanetData> stars;
+    std::vector<PointLight> lights_;
 
-    void DrawPlanet(PlanetData& planet, Shader& shader)
+    static ObjectInstance meshInstance(const PlanetData& planet, int lightingTile)
     {
         glm::mat4 m = glm::mat4(1.0f);
         m = glm::translate(m, planet.scale_factor*planet.postion);
         m = glm::scale(m, glm::vec3(planet.scale_factor, planet.scale_factor, planet.scale_factor));
-        shader.setMat4("model", m);
-        shader.setVec3("position", planet.postion);
-        shader.setVec3("objectColor", planet.color);
-        glDrawElements(GL_TRIANGLES, sphere_.indices.size(), GL_UNSIGNED_INT, 0);
+        return ObjectInstance{ m, planet.color, lightingTile };
+    }
+
+    template<typename C>
+    std::vector<C> groupCommands(C command) const
+    {
+        std::vector<C> commands(2, command);
+        commands[0].instanceCount = starsCount_;
+        commands[1].instanceCount = planetsCount;
+        commands[1].baseInstance = starsCount_;
+        return commands;
+    }
+
+    // spheres fall back to impostors when the LOD meshes could not be uploaded
+    bool drawImpostors(const RenderContext& context) const
+    {
+        return context.colors.impostors || lodGeometry_.indexCount == 0;
+    }
+
+    static int lodSegments(int lod)
+    {
+        return 8 << lod;
+    }
+
+    // projected radius in pixels above which the LOD's edges get longer than lodEdgePixels
+    static float lodMaxRadius(int lod)
+    {
+        return lodSegments(lod) * lodEdgePixels / (2.0f * static_cast<float>(M_PI));
+    }
+
+    static int selectLod(int lod, float radius)
+    {
+        while (lod + 1 < lodCount && radius > lodMaxRadius(lod) * (1.0f + lodHysteresis))
+            ++lod;
+        while (lod > 0 && radius < lodMaxRadius(lod - 1) * (1.0f - lodHysteresis))
+            --lod;
+        return lod;
+    }
+
+    int groupOf(uint32_t index) const
+    {
+        return index < static_cast<uint32_t>(starsCount_) ? 0 : 1;
+    }
+
+    uint32_t batchOf(uint32_t index, bool lods) const
+    {
+        return lods ? groupOf(index) * lodCount + instanceLods_[index] : groupOf(index);
+    }
+
+    static DrawArraysIndirectCommand impostorCommand()
+    {
+        return DrawArraysIndirectCommand{ 4, 0, 0, 0 };
+    }
+
+    void updateLods(const RenderContext& context)
+    {
+        bool changed = false;
+        for (uint32_t i = 0; i < instanceLods_.size(); ++i)
+        {
+            float radius = context.projectedRadius(glm::vec3(bounds_[i]), bounds_[i].w);
+            int lod = selectLod(instanceLods_[i], radius);
+            changed |= lod != instanceLods_[i];
+            instanceLods_[i] = lod;
+            if (context.colors.shadingLod && groupOf(i) == 1 && lod < gouraudLods && context.frustum.intersects(bounds_[i]))
+                context.shadingLod->addSaved(radius);
+        }
+        if (changed)
+            rebuild_lod_batches();
+    }
+
+    void rebuild_lod_batches()
+    {
+        std::vector<std::vector<uint32_t>> members(2 * lodCount);
+        for (uint32_t i = 0; i < instanceLods_.size(); ++i)
+            members[batchOf(i, true)].push_back(i);
+
+        std::vector<ObjectInstance> instances;
+        std::vector<glm::vec4> bounds;
+        instances.reserve(meshInstances_.size());
+        bounds.reserve(bounds_.size());
+        for (int batch = 0; batch < 2 * lodCount; ++batch)
+        {
+            const SphereLod& lod = lods_[batch % lodCount];
+            meshBatches_[batch] = DrawElementsIndirectCommand{ lod.indexCount, static_cast<GLuint>(members[batch].size()),
+                                                               lod.firstIndex, lod.baseVertex, static_cast<GLuint>(instances.size()) };
+            for (uint32_t index : members[batch])
+            {
+                instances.push_back(meshInstances_[index]);
+                bounds.push_back(bounds_[index]);
+            }
+        }
+
+        GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, meshInstanceVBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instances.size() * sizeof(ObjectInstance), instances.data());
+        GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, meshBoundsBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bounds.size() * sizeof(glm::vec4), bounds.data());
+        GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, meshCommands);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, meshBatches_.size() * sizeof(DrawElementsIndirectCommand), meshBatches_.data());
+    }
+
+    template<typename I, typename C>
+    void uploadVisible(const std::vector<I>& instances, GLuint visibleInstances, GLuint commands, std::vector<C> batches, bool lods)
+    {
+        std::vector<I> visible(instances.size());
+        for (auto& batch : batches)
+            batch.instanceCount = 0;
+        for (uint32_t index : visible_)
+        {
+            C& batch = batches[batchOf(index, lods)];
+            visible[batch.baseInstance + batch.instanceCount++] = instances[index];
+        }
+
+        GLState::bindBuffer(GL_ARRAY_BUFFER, visibleInstances);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, visible.size() * sizeof(I), visible.data());
+        GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, batches.size() * sizeof(C), batches.data());
+    }
+
+    template<typename C>
+    void cullBatches(GpuCuller& culler, GLuint bounds, const std::vector<C>& batches, GLuint instances,
+                     GLsizei instanceSize, GLuint visibleInstances, GLuint commands, bool elements)
+    {
+        for (size_t i = 0; i < batches.size(); ++i)
+            culler.cullInstances(bounds, batches[i].baseInstance, batches[i].instanceCount, instances, instanceSize,
+                                 visibleInstances, commands, i * sizeof(C), elements);
+    }
+
+    DrawPacket meshPacket(Shader& shader, Shader& depthShader, GLintptr commandOffset, GLsizei lods)
+    {
+        DrawPacket packet = DrawPacket::elementsIndirect(VAO, meshCommands, lods, commandOffset);
+        packet.indexType = lodGeometry_.indexType;
+        packet.shader = &shader;
+        packet.depthShader = &depthShader;
+        return packet;
+    }
+
+    DrawPacket impostorPacket(Shader& shader, Shader& depthShader, GLintptr commandOffset)
+    {
+        DrawPacket packet = DrawPacket::arraysIndirect(impostorVAO, GL_TRIANGLE_STRIP, impostorCommands, 1, commandOffset);
+        packet.shader = &shader;
+        packet.depthShader = &depthShader;
+        return packet;
     }
 
     void generate_graphics_data()
     {
-        glGenVertexArrays(1, &VAO);
-        glBindVertexArray(VAO);
+        std::vector<PositionNormalVertex> vertices;
+        std::vector<unsigned int> indices;
+        for (int lod = 0; lod < lodCount; ++lod)
+        {
+            int segments = lodSegments(lod);
+            Sphere sphere(segments, segments);
+            std::vector<PositionNormalVertex> lodVertices = sphere.trianglesData;
+            std::vector<unsigned int> lodIndices(sphere.indices.begin(), sphere.indices.end());
+            MeshOptimizer::optimize("sphere " + std::to_string(segments) + "x" + std::to_string(segments), lodVertices, lodIndices);
+
+            lods_[lod] = SphereLod{ static_cast<GLuint>(indices.size()), static_cast<GLuint>(lodIndices.size()),
+                                    static_cast<GLint>(vertices.size()) };
+            vertices.insert(vertices.end(), lodVertices.begin(), lodVertices.end());
+            indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+        }
+        if (!GeometryMemory::upload(vertices, indices, lodGeometry_))
+            std::cout << "ERROR::PLANETS::LOD_GEOMETRY_NOT_UPLOADED drawing impostors" << std::endl;
+        for (auto& lod : lods_)
+        {
+            lod.firstIndex += lodGeometry_.firstIndex;
+            lod.baseVertex += lodGeometry_.baseVertex;
+        }
+        VAO = GeometryMemory::createVertexArray<PositionNormalVertex>();
+    }
 
-        glGenBuffers(1, &VBO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sphere_.trianglesData.size() * sizeof(float), sphere_.trianglesData.data(), GL_STATIC_DRAW);
+    void generate_bounds()
+    {
+        bounds_.reserve(starsCount_ + planetsCount);
+        for (auto& star : stars)
+            bounds_.push_back(glm::vec4(star.scale_factor * star.postion, star.scale_factor));
+        for (auto& planet : planets)
+            bounds_.push_back(glm::vec4(planet.scale_factor * planet.postion, planet.scale_factor));
+        cachedSpheres_.assign(bounds_.begin() + starsCount_, bounds_.end());
+
+        spheres_.reserve(bounds_.size());
+        for (auto& sphere : bounds_)
+            spheres_.add(sphere);
+        createBuffer(GL_SHADER_STORAGE_BUFFER, bounds_, boundsBuffer);
+        createBuffer(GL_SHADER_STORAGE_BUFFER, bounds_, meshBoundsBuffer, GL_DYNAMIC_DRAW);
+    }
+
+    void generate_mesh_instances()
+    {
+        meshInstances_.reserve(starsCount_ + planetsCount);
+        for (auto& star : stars)
+            meshInstances_.push_back(meshInstance(star, -1));
+        for (int i = 0; i < planetsCount; ++i)
+            meshInstances_.push_back(meshInstance(planets[i], i));
 
-        glGenBuffers(1, &EBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO); 
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphere_.indices.size() * sizeof(int), sphere_.indices.data(), GL_STATIC_DRAW);
+        instanceLods_.assign(meshInstances_.size(), 0);
+        meshBatches_.resize(2 * lodCount);
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, false, 6 * sizeof(float), (void*)0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, false, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glBindVertexArray(0);
+        createBuffer(GL_SHADER_STORAGE_BUFFER, meshInstances_, meshInstanceVBO, GL_DYNAMIC_DRAW);
+        attachInstanceBuffer(VAO, meshInstances_, visibleMeshInstanceVBO, GL_DYNAMIC_COPY);
+        createBuffer(GL_DRAW_INDIRECT_BUFFER, meshBatches_, meshCommands, GL_DYNAMIC_DRAW);
+        rebuild_lod_batches();
+    }
+
+    void generate_impostor_data()
+    {
+        std::vector<QuadVertex> quad = {
+            { glm::vec2(-1.0f, -1.0f) },
+            { glm::vec2(1.0f, -1.0f) },
+            { glm::vec2(-1.0f, 1.0f) },
+            { glm::vec2(1.0f, 1.0f) }
+        };
+
+        sphereInstances_.reserve(starsCount_ + planetsCount);
+        for (auto& star : stars)
+            sphereInstances_.push_back(SphereInstance{ star.scale_factor * star.postion, star.scale_factor, star.color });
+        for (int i = 0; i < planetsCount; ++i)
+            sphereInstances_.push_back(SphereInstance{ planets[i].scale_factor * planets[i].postion, planets[i].scale_factor, planets[i].color, i });
+
+        impostorVAO = createVertexArray(quad, quadVBO);
+        createBuffer(GL_SHADER_STORAGE_BUFFER, sphereInstances_, instanceVBO);
+        attachInstanceBuffer(impostorVAO, sphereInstances_, visibleInstanceVBO, GL_DYNAMIC_COPY);
+        impostorBatches_ = groupCommands(impostorCommand());
+
+        glGenVertexArrays(1, &shadowVAO);
+        GLState::bindVertexArray(shadowVAO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        bindVertexLayout<QuadVertex>();
+        GLState::bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        bindVertexLayout<SphereInstance>(1);
+        createBuffer(GL_DRAW_INDIRECT_BUFFER, impostorBatches_, impostorCommands, GL_DYNAMIC_DRAW);
     }
 
     void generate_planets()
@@ -215,15 +543,20 @@ private:
         }
     }
 
-    void generate_stars()
+    void generate_stars(bool starField)
     {
-        std::mt19937 gen(SEED);
+        std::mt19937 gen(starField ? SEED + 1 : SEED);
         std::uniform_real_distribution<> scale(1, 1);
-        std::uniform_real_distribution<> position_x(-10, 10);
-        std::uniform_real_distribution<> position_z(5, 20);
+        std::uniform_real_distribution<> position_x(starField ? -20 : -10, starField ? 20 : 10);
+        std::uniform_real_distribution<> position_z(starField ? -10 : 5, starField ? 100 : 20);
         std::uniform_real_distribution<> color(0.95, 1);
+        // star field lights reach ~12 units instead of ~300, so each cluster only lists its neighbours
+        const glm::vec3 attenuation = starField ? glm::vec3(1.0f, 0.7f, 1.8f) : glm::vec3(1.0f, 0.027f, 0.0028f);
 
-        for (int i = 0; i < lightSpotsCount; ++i)
+        stars.resize(starsCount_);
+        lights_.clear();
+        lights_.reserve(starsCount_);
+        for (int i = 0; i < starsCount_; ++i)
         {
             glm::vec3 pos = glm::vec3(position_x(gen), position_x(gen), position_z(gen));
             glm::vec3 col = glm::vec3(color(gen), color(gen), color(gen));
@@ -235,13 +568,14 @@ private:
                 sc
             },
 
-            lightSpots[i] = PointLight{
+            lights_.push_back(PointLight{
                     pos,
                     0.1f * col,
                     0.5f * col,
                     1.f * col,
-                    1.0, 0.027f, 0.0028f
-            };
+                    attenuation.x, attenuation.y, attenuation.z,
+                    sc
+            });
         }
     }
 };
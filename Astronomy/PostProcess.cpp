@@ -0,0 +1,218 @@
+#include "PostProcess.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    // no pass blends with destination alpha, so the scene drops it and moves half the bytes of RGBA16F
+    const GLenum SceneFormat = GL_R11F_G11F_B10F;
+    const GLenum BloomFormat = GL_R11F_G11F_B10F;
+    const GLenum DepthFormat = GL_DEPTH_COMPONENT24;
+
+    GLuint createDepthBuffer(GLsizei samples, GLsizei width, GLsizei height)
+    {
+        GLuint renderbuffer;
+        glGenRenderbuffers(1, &renderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, DepthFormat, width, height);
+        return renderbuffer;
+    }
+}
+
+PostProcess::PostProcess()
+    :prefilter_("fullscreen.vert", "bloom.frag", ShaderDefines{ { "PREFILTER", "" } }),
+    downsample_("fullscreen.vert", "bloom.frag"),
+    upsample_("fullscreen.vert", "bloom.frag", ShaderDefines{ { "UPSAMPLE", "" } }),
+    composite_("fullscreen.vert", "composite.frag")
+{
+    glGenVertexArrays(1, &vao_);
+    glGenQueries(QueryFrames, queries_);
+    for (Shader* shader : { &prefilter_, &downsample_, &upsample_ })
+        shader->bindSampler("source", 0);
+    composite_.bindSampler("scene", 0);
+    composite_.bindSampler("bloom", 1);
+}
+
+PostProcess::~PostProcess()
+{
+    release();
+    GLState::deleteVertexArray(vao_);
+    glDeleteQueries(QueryFrames, queries_);
+}
+
+void PostProcess::beginScene(int width, int height, const glm::vec3& background)
+{
+    if (width != width_ || height != height_)
+        resize(width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, msaaFramebuffer_);
+    glViewport(0, 0, width_, height_);
+    GLState::depthMask(GL_TRUE);
+    glClearColor(background.r, background.g, background.b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void PostProcess::resolve(bool depth)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, msaaFramebuffer_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFramebuffer_);
+    glBlitFramebuffer(0, 0, width_, height_, 0, 0, width_, height_,
+                      GL_COLOR_BUFFER_BIT | (depth ? GL_DEPTH_BUFFER_BIT : 0), GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer_);
+}
+
+void PostProcess::present(int bloomLevels)
+{
+    collectQueries();
+    bool timing = !queryPending_[queryFrame_];
+    if (timing)
+        glBeginQuery(GL_TIME_ELAPSED, queries_[queryFrame_]);
+
+    GLState::setEnabled(GL_DEPTH_TEST, false);
+    int levels = std::min(bloomLevels, static_cast<int>(levels_.size()));
+    if (levels > 0)
+        blur(levels);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width_, height_);
+    composite_.use();
+    composite_.setFloat("bloomIntensity", levels > 0 ? BloomIntensity : 0.0f);
+    composite_.setFloat("exposure", Exposure);
+    GLState::bindTexture(0, GL_TEXTURE_2D, sceneColor_);
+    GLState::bindTexture(1, GL_TEXTURE_2D, levels > 0 ? levels_[0].texture : 0);
+    GLState::bindVertexArray(vao_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    GLState::setEnabled(GL_DEPTH_TEST, true);
+
+    if (timing)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryPending_[queryFrame_] = true;
+    }
+    queryFrame_ = (queryFrame_ + 1) % QueryFrames;
+}
+
+// down the chain with the 5-tap filter, then back up with the 8-tap one, adding each level onto the next larger
+void PostProcess::blur(int levels)
+{
+    Level scene{ sceneColor_, sceneFramebuffer_, width_, height_ };
+    prefilter_.use();
+    prefilter_.setFloat("threshold", BloomThreshold);
+    drawPass(prefilter_, scene.texture, scene.width, scene.height, levels_[0]);
+    for (int level = 1; level < levels; ++level)
+        drawPass(downsample_, levels_[level - 1].texture, levels_[level - 1].width, levels_[level - 1].height, levels_[level]);
+
+    GLState::setEnabled(GL_BLEND, true);
+    GLState::blendFunc(GL_ONE, GL_ONE);
+    for (int level = levels - 2; level >= 0; --level)
+        drawPass(upsample_, levels_[level + 1].texture, levels_[level + 1].width, levels_[level + 1].height, levels_[level]);
+    GLState::setEnabled(GL_BLEND, false);
+}
+
+void PostProcess::drawPass(Shader& shader, GLuint source, GLsizei sourceWidth, GLsizei sourceHeight, const Level& target)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glViewport(0, 0, target.width, target.height);
+    shader.use();
+    shader.setVec2("halfTexel", glm::vec2(0.5f / sourceWidth, 0.5f / sourceHeight));
+    GLState::bindTexture(0, GL_TEXTURE_2D, source);
+    GLState::bindVertexArray(vao_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void PostProcess::collectQueries()
+{
+    for (int slot = 0; slot < QueryFrames; ++slot)
+    {
+        if (!queryPending_[slot])
+            continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(queries_[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries_[slot], GL_QUERY_RESULT, &nanoseconds);
+        milliseconds_ = static_cast<float>(nanoseconds) * 1e-6f;
+        queryPending_[slot] = false;
+    }
+}
+
+float PostProcess::getLastMilliseconds() const
+{
+    return milliseconds_;
+}
+
+void PostProcess::resize(int width, int height)
+{
+    release();
+    width_ = std::max(width, 1);
+    height_ = std::max(height, 1);
+
+    glGenTextures(1, &msaaColor_);
+    GLState::bindTexture(0, GL_TEXTURE_2D_MULTISAMPLE, msaaColor_);
+    glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, Samples, SceneFormat, width_, height_, GL_TRUE);
+    msaaDepth_ = createDepthBuffer(Samples, width_, height_);
+    msaaFramebuffer_ = createFramebuffer(GL_TEXTURE_2D_MULTISAMPLE, msaaColor_, msaaDepth_);
+
+    sceneColor_ = createTexture(SceneFormat, width_, height_);
+    sceneDepth_ = createDepthBuffer(0, width_, height_);
+    sceneFramebuffer_ = createFramebuffer(GL_TEXTURE_2D, sceneColor_, sceneDepth_);
+
+    for (int level = 0; level < MaxBloomLevels; ++level)
+    {
+        GLsizei levelWidth = width_ >> (level + 1);
+        GLsizei levelHeight = height_ >> (level + 1);
+        if (levelWidth < 1 || levelHeight < 1)
+            break;
+        GLuint texture = createTexture(BloomFormat, levelWidth, levelHeight);
+        levels_.push_back(Level{ texture, createFramebuffer(GL_TEXTURE_2D, texture, 0), levelWidth, levelHeight });
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void PostProcess::release()
+{
+    for (const Level& level : levels_)
+    {
+        glDeleteFramebuffers(1, &level.framebuffer);
+        GLState::deleteTexture(level.texture);
+    }
+    levels_.clear();
+
+    glDeleteFramebuffers(1, &msaaFramebuffer_);
+    glDeleteFramebuffers(1, &sceneFramebuffer_);
+    glDeleteRenderbuffers(1, &msaaDepth_);
+    glDeleteRenderbuffers(1, &sceneDepth_);
+    GLState::deleteTexture(msaaColor_);
+    GLState::deleteTexture(sceneColor_);
+    msaaFramebuffer_ = sceneFramebuffer_ = msaaDepth_ = sceneDepth_ = msaaColor_ = sceneColor_ = 0;
+}
+
+GLuint PostProcess::createTexture(GLenum format, GLsizei width, GLsizei height)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GLState::bindTexture(0, GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+GLuint PostProcess::createFramebuffer(GLenum colorTarget, GLuint color, GLuint depth)
+{
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTarget, color, 0);
+    if (depth)
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::POST_PROCESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    return framebuffer;
+}
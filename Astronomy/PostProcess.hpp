@@ -0,0 +1,63 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Shader.hpp"
+
+// Multisampled HDR scene target, a dual-filter (Kawase) bloom chain at halving resolutions
+// and a tonemapped composite into the default framebuffer.
+class PostProcess
+{
+public:
+    static const GLsizei Samples = 4;
+    static const int MaxBloomLevels = 6;
+    static constexpr float BloomThreshold = 1.0f;
+    static constexpr float BloomIntensity = 0.6f;
+    static constexpr float Exposure = 1.0f;
+    static const int QueryFrames = 3;
+
+    PostProcess();
+    ~PostProcess();
+
+    PostProcess(const PostProcess&) = delete;
+    PostProcess& operator=(const PostProcess&) = delete;
+
+    // binds and clears the HDR target, following the window size
+    void beginScene(int width, int height, const glm::vec3& background);
+    // leaves the resolved scene bound for reading; depth is only resolved when something copies it
+    void resolve(bool depth);
+    // bloomLevels == 0 skips the bloom chain
+    void present(int bloomLevels);
+
+    float getLastMilliseconds() const;
+
+private:
+    struct Level
+    {
+        GLuint texture;
+        GLuint framebuffer;
+        GLsizei width;
+        GLsizei height;
+    };
+
+    Shader prefilter_, downsample_, upsample_, composite_;
+    GLuint vao_;
+    GLuint msaaFramebuffer_ = 0, msaaColor_ = 0, msaaDepth_ = 0;
+    GLuint sceneFramebuffer_ = 0, sceneColor_ = 0, sceneDepth_ = 0;
+    std::vector<Level> levels_;
+    int width_ = 0;
+    int height_ = 0;
+
+    GLuint queries_[QueryFrames];
+    bool queryPending_[QueryFrames] = {};
+    int queryFrame_ = 0;
+    float milliseconds_ = 0.0f;
+
+    void resize(int width, int height);
+    void release();
+    void blur(int levels);
+    void drawPass(Shader& shader, GLuint source, GLsizei sourceWidth, GLsizei sourceHeight, const Level& target);
+    void collectQueries();
+    static GLuint createTexture(GLenum format, GLsizei width, GLsizei height);
+    static GLuint createFramebuffer(GLenum colorTarget, GLuint color, GLuint depth);
+};
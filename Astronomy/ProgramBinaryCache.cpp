@@ -0,0 +1,136 @@
+#include "ProgramBinaryCache.hpp"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    const uint32_t CacheMagic = 0x42545341; // "ASTB"
+    const uint32_t CacheVersion = 1;
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;
+        uint32_t length;
+    };
+
+    std::string glString(GLenum name)
+    {
+        const GLubyte* value = glGetString(name);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+}
+
+std::string ProgramBinaryCache::directory_ = "shader_cache";
+
+void ProgramBinaryCache::setDirectory(const std::string& directory)
+{
+    directory_ = directory;
+}
+
+bool ProgramBinaryCache::enabled()
+{
+    static int formats = -1;
+    if (formats < 0)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return !directory_.empty() && formats > 0;
+}
+
+uint64_t ProgramBinaryCache::makeKey(const std::string& vertexCode, const std::string& fragmentCode)
+{
+    std::string driver = glString(GL_VENDOR) + '\n' + glString(GL_RENDERER) + '\n' + glString(GL_VERSION);
+
+    uint64_t key = hash(&CacheVersion, sizeof(CacheVersion), 14695981039346656037ull);
+    key = hash(driver.data(), driver.size() + 1, key);
+    key = hash(vertexCode.data(), vertexCode.size() + 1, key);
+    key = hash(fragmentCode.data(), fragmentCode.size() + 1, key);
+    return key;
+}
+
+bool ProgramBinaryCache::load(GLuint program, uint64_t key)
+{
+    if (!enabled())
+        return false;
+
+    std::ifstream file(pathFor(key), std::ios::binary);
+    if (!file)
+        return false;
+
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || header.magic != CacheMagic || header.version != CacheVersion || header.key != key)
+        return false;
+
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size()))
+        return false;
+
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+        std::cout << "WARNING::PROGRAM_BINARY_CACHE::BINARY_REJECTED: " << pathFor(key) << std::endl;
+    return success != 0;
+}
+
+void ProgramBinaryCache::store(GLuint program, uint64_t key)
+{
+    if (!enabled())
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+#ifdef _WIN32
+    _mkdir(directory_.c_str());
+#else
+    mkdir(directory_.c_str(), 0755);
+#endif
+
+    std::ofstream file(pathFor(key), std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cout << "WARNING::PROGRAM_BINARY_CACHE::CANNOT_WRITE: " << pathFor(key) << std::endl;
+        return;
+    }
+
+    CacheHeader header = { CacheMagic, CacheVersion, key, format, static_cast<uint32_t>(length) };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), length);
+}
+
+std::string ProgramBinaryCache::pathFor(uint64_t key)
+{
+    std::ostringstream path;
+    path << directory_ << '/' << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    return path.str();
+}
+
+uint64_t ProgramBinaryCache::hash(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
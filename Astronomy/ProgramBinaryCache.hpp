@@ -0,0 +1,21 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+class ProgramBinaryCache
+{
+public:
+    static void setDirectory(const std::string& directory);
+    static bool enabled();
+
+    static uint64_t makeKey(const std::string& vertexCode, const std::string& fragmentCode);
+    static bool load(GLuint program, uint64_t key);
+    static void store(GLuint program, uint64_t key);
+
+private:
+    static std::string directory_;
+
+    static std::string pathFor(uint64_t key);
+    static uint64_t hash(const void* data, size_t size, uint64_t seed);
+};
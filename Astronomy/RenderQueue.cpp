@@ -0,0 +1,263 @@
+#include "RenderQueue.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <cstring>
+
+DrawPacket DrawPacket::arrays(GLuint vao, GLenum mode, GLint first, GLsizei count, GLsizei instanceCount, GLuint baseInstance)
+{
+    DrawPacket packet;
+    packet.vao = vao;
+    packet.command = ARRAYS;
+    packet.mode = mode;
+    packet.first = first;
+    packet.count = count;
+    packet.instanceCount = instanceCount;
+    packet.baseInstance = baseInstance;
+    return packet;
+}
+
+DrawPacket DrawPacket::elements(GLuint vao, GLsizei count, GLsizei instanceCount, GLuint baseInstance)
+{
+    DrawPacket packet;
+    packet.vao = vao;
+    packet.command = ELEMENTS;
+    packet.count = count;
+    packet.instanceCount = instanceCount;
+    packet.baseInstance = baseInstance;
+    return packet;
+}
+
+DrawPacket DrawPacket::arraysIndirect(GLuint vao, GLenum mode, GLuint indirectBuffer, GLsizei drawCount, GLintptr offset)
+{
+    DrawPacket packet;
+    packet.vao = vao;
+    packet.command = ARRAYS_INDIRECT;
+    packet.mode = mode;
+    packet.indirectBuffer = indirectBuffer;
+    packet.indirectOffset = offset;
+    packet.count = drawCount;
+    return packet;
+}
+
+DrawPacket DrawPacket::elementsIndirect(GLuint vao, GLuint indirectBuffer, GLsizei drawCount, GLintptr offset)
+{
+    DrawPacket packet;
+    packet.vao = vao;
+    packet.command = ELEMENTS_INDIRECT;
+    packet.indirectBuffer = indirectBuffer;
+    packet.indirectOffset = offset;
+    packet.count = drawCount;
+    return packet;
+}
+
+RenderQueue::RenderQueue()
+    :instances_(GL_ARRAY_BUFFER, MaxStreamedInstances * sizeof(ObjectInstance))
+{
+    glGenQueries(QueryFrames * QUERY_COUNT, &queries_[0][0]);
+}
+
+RenderQueue::~RenderQueue()
+{
+    glDeleteQueries(QueryFrames * QUERY_COUNT, &queries_[0][0]);
+}
+
+void RenderQueue::beginFrame()
+{
+    instances_.beginFrame();
+}
+
+ObjectInstance* RenderQueue::allocateInstances(GLsizei count, GLuint& baseInstance)
+{
+    GLintptr offset = 0;
+    void* data = instances_.allocate(count * sizeof(ObjectInstance), sizeof(ObjectInstance), offset);
+    baseInstance = static_cast<GLuint>(offset / sizeof(ObjectInstance));
+    return static_cast<ObjectInstance*>(data);
+}
+
+void RenderQueue::submit(const DrawPacket& packet)
+{
+    order_.emplace_back(makeKey(packet), static_cast<uint32_t>(packets_.size()));
+    packets_.push_back(packet);
+}
+
+// [63..48] program | [47..24] material | [23..0] view depth, front to back
+uint64_t RenderQueue::makeKey(const DrawPacket& packet)
+{
+    uint64_t program = packet.shader ? packet.shader->getId() & 0xFFFF : 0;
+    uint64_t material = packet.material ? (packet.material->getId() + 1) & 0xFFFFFF : 0;
+
+    // non-negative floats order like their bit patterns; keep sign, exponent and 15 mantissa bits
+    float depth = std::max(packet.depth, 0.0f);
+    uint32_t depthBits;
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+    uint64_t quantizedDepth = depthBits >> 8;
+
+    return program << 48 | material << 24 | quantizedDepth;
+}
+
+// With the pre-pass on, packets that have a depth shader lay down depth first and are then shaded with
+// GL_EQUAL, so each visible pixel runs the lighting shader once.
+void RenderQueue::flush(bool depthPrepass)
+{
+    std::sort(order_.begin(), order_.end());
+    instances_.finishWrites();
+    collectOverdrawQueries();
+
+    int slot = queryFrame_++ % QueryFrames;
+    if (depthPrepass)
+    {
+        glBeginQuery(GL_SAMPLES_PASSED, queries_[slot][PREPASS_SAMPLES]);
+        depthPass();
+        glEndQuery(GL_SAMPLES_PASSED);
+        glBeginQuery(GL_SAMPLES_PASSED, queries_[slot][SHADED_SAMPLES]);
+    }
+
+    Shader* shader = nullptr;
+    const Material* material = nullptr;
+
+    for (auto& entry : order_)
+    {
+        const DrawPacket& packet = packets_[entry.second];
+        bool prepassed = depthPrepass && packet.depthShader;
+        GLState::depthFunc(prepassed ? GL_EQUAL : GL_LESS);
+        GLState::depthMask(prepassed ? GL_FALSE : GL_TRUE);
+        if (packet.shader != shader)
+        {
+            shader = packet.shader;
+            shader->use();
+        }
+        if (packet.material && packet.material != material)
+        {
+            material = packet.material;
+            material->bind();
+        }
+        if (packet.streamed)
+            attachInstanceStream(packet.vao);
+
+        execute(packet);
+    }
+    GLState::depthFunc(GL_LESS);
+    GLState::depthMask(GL_TRUE);
+
+    if (depthPrepass)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        queryPending_[slot] = true;
+    }
+    instances_.endFrame();
+
+    lastPacketCount_ = packets_.size();
+    packets_.clear();
+    order_.clear();
+}
+
+// Draws only the depth shaders, e.g. into a shadow map. Later passes keep allocating from the same
+// instance frame, only flush() fences and retires it.
+void RenderQueue::flushDepth()
+{
+    std::sort(order_.begin(), order_.end());
+    instances_.finishWrites();
+    depthPass();
+
+    packets_.clear();
+    order_.clear();
+}
+
+size_t RenderQueue::getLastPacketCount() const
+{
+    return lastPacketCount_;
+}
+
+float RenderQueue::getPrepassSavings() const
+{
+    return prepassSavings_;
+}
+
+void RenderQueue::depthPass()
+{
+    GLState::colorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    GLState::depthFunc(GL_LESS);
+    GLState::depthMask(GL_TRUE);
+
+    Shader* shader = nullptr;
+    for (auto& entry : order_)
+    {
+        const DrawPacket& packet = packets_[entry.second];
+        if (!packet.depthShader)
+            continue;
+        if (packet.depthShader != shader)
+        {
+            shader = packet.depthShader;
+            shader->use();
+        }
+        if (packet.streamed)
+            attachInstanceStream(packet.vao);
+
+        execute(packet);
+    }
+    GLState::colorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// fraction of lighting-shader fragments the pre-pass avoided, read back a few frames late to avoid stalls
+void RenderQueue::collectOverdrawQueries()
+{
+    for (int slot = 0; slot < QueryFrames; ++slot)
+    {
+        if (!queryPending_[slot])
+            continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(queries_[slot][SHADED_SAMPLES], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint prepassSamples = 0, shadedSamples = 0;
+        glGetQueryObjectuiv(queries_[slot][PREPASS_SAMPLES], GL_QUERY_RESULT, &prepassSamples);
+        glGetQueryObjectuiv(queries_[slot][SHADED_SAMPLES], GL_QUERY_RESULT, &shadedSamples);
+        prepassSavings_ = prepassSamples ? 1.0f - static_cast<float>(shadedSamples) / prepassSamples : 0.0f;
+        queryPending_[slot] = false;
+    }
+}
+
+void RenderQueue::attachInstanceStream(GLuint vao)
+{
+    if (!streamedVaos_.insert(vao).second)
+        return;
+
+    GLState::bindVertexArray(vao);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, instances_.getBuffer());
+    bindVertexLayout<ObjectInstance>(1);
+}
+
+void RenderQueue::execute(const DrawPacket& packet)
+{
+    GLState::bindVertexArray(packet.vao);
+    switch (packet.command)
+    {
+    case DrawPacket::ARRAYS:
+        if (packet.instanceCount == 1 && packet.baseInstance == 0)
+            glDrawArrays(packet.mode, packet.first, packet.count);
+        else
+            glDrawArraysInstancedBaseInstance(packet.mode, packet.first, packet.count, packet.instanceCount, packet.baseInstance);
+        break;
+    case DrawPacket::ELEMENTS:
+    {
+        GLsizeiptr indexSize = packet.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        const void* indices = reinterpret_cast<const void*>(packet.first * indexSize);
+        if (packet.instanceCount == 1 && packet.baseInstance == 0)
+            glDrawElementsBaseVertex(GL_TRIANGLES, packet.count, packet.indexType, indices, packet.baseVertex);
+        else
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, packet.count, packet.indexType, indices,
+                                                          packet.instanceCount, packet.baseVertex, packet.baseInstance);
+        break;
+    }
+    case DrawPacket::ARRAYS_INDIRECT:
+        GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, packet.indirectBuffer);
+        glMultiDrawArraysIndirect(packet.mode, reinterpret_cast<const void*>(packet.indirectOffset), packet.count, 0);
+        break;
+    case DrawPacket::ELEMENTS_INDIRECT:
+        GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, packet.indirectBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, packet.indexType, reinterpret_cast<const void*>(packet.indirectOffset), packet.count, 0);
+        break;
+    }
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "Shader.hpp"
+#include "StreamBuffer.hpp"
+#include "VertexFormat.hpp"
+#include "Material.hpp"
+#include "ShadersPack.hpp"
+#include "DataContainers.hpp"
+#include "Culling.hpp"
+#include "ShadingLod.hpp"
+
+struct ObjectInstance
+{
+    glm::mat4 model;
+    glm::vec3 color;
+    int lightingTile = -1;
+};
+
+template<>
+struct VertexLayout<ObjectInstance>
+{
+    static constexpr std::array<VertexAttribute, 3> attributes()
+    {
+        return {{
+            VERTEX_ATTRIBUTE(ObjectInstance, model, 8),
+            VERTEX_ATTRIBUTE(ObjectInstance, color, 12),
+            VERTEX_ATTRIBUTE(ObjectInstance, lightingTile, 13),
+        }};
+    }
+};
+
+struct DrawPacket
+{
+    enum Command
+    {
+        ARRAYS,
+        ELEMENTS,
+        ARRAYS_INDIRECT,
+        ELEMENTS_INDIRECT
+    };
+
+    Shader* shader = nullptr;
+    Shader* depthShader = nullptr;
+    const Material* material = nullptr;
+    GLuint vao = 0;
+    Command command = ARRAYS;
+    GLenum mode = GL_TRIANGLES;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLint first = 0;
+    GLint baseVertex = 0;
+    GLsizei count = 0;
+    GLsizei instanceCount = 1;
+    GLuint baseInstance = 0;
+    GLuint indirectBuffer = 0;
+    GLintptr indirectOffset = 0;
+    bool streamed = false;
+    float depth = 0.0f;
+
+    static DrawPacket arrays(GLuint vao, GLenum mode, GLint first, GLsizei count, GLsizei instanceCount = 1, GLuint baseInstance = 0);
+    static DrawPacket elements(GLuint vao, GLsizei count, GLsizei instanceCount = 1, GLuint baseInstance = 0);
+    static DrawPacket arraysIndirect(GLuint vao, GLenum mode, GLuint indirectBuffer, GLsizei drawCount, GLintptr offset = 0);
+    static DrawPacket elementsIndirect(GLuint vao, GLuint indirectBuffer, GLsizei drawCount, GLintptr offset = 0);
+};
+
+struct RenderContext
+{
+    ShadersPack& shaders;
+    const ColoringData& colors;
+    glm::mat4 view;
+    Frustum frustum;
+    float pixelScale;
+    ShadingLod* shadingLod;
+
+    Shader& shader(ShaderPermutation::Object object, bool star = false, bool lightingCache = false) const
+    {
+        return shaders.acquire(ShaderPermutation(object, colors.gouraud, colors.blinn, star, false, false, lightingCache));
+    }
+
+    // the program picked per object by the shading LOD instead of the scene-wide toggle
+    Shader& lodShader(ShaderPermutation::Object object, bool gouraud, bool lightingCache = false) const
+    {
+        return shaders.acquire(ShaderPermutation(object, gouraud, colors.blinn, false, false, false, lightingCache));
+    }
+
+    Shader& depthShader(ShaderPermutation::Object object) const
+    {
+        return shaders.acquire(ShaderPermutation::depthPass(object));
+    }
+
+    float depthOf(const glm::vec3& position) const
+    {
+        return glm::max(0.0f, -(view * glm::vec4(position, 1.0f)).z);
+    }
+
+    float projectedRadius(const glm::vec3& center, float radius) const
+    {
+        return radius * pixelScale / glm::max(depthOf(center), radius);
+    }
+};
+
+class RenderQueue
+{
+public:
+    static const GLsizei MaxStreamedInstances = 4096;
+    static const int QueryFrames = 3;
+
+    RenderQueue();
+    ~RenderQueue();
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    void beginFrame();
+    ObjectInstance* allocateInstances(GLsizei count, GLuint& baseInstance);
+    void submit(const DrawPacket& packet);
+    void flush(bool depthPrepass = false);
+    void flushDepth();
+
+    size_t getLastPacketCount() const;
+    float getPrepassSavings() const;
+
+    static uint64_t makeKey(const DrawPacket& packet);
+
+private:
+    std::vector<DrawPacket> packets_;
+    std::vector<std::pair<uint64_t, uint32_t>> order_;
+    size_t lastPacketCount_ = 0;
+    StreamBuffer instances_;
+    std::unordered_set<GLuint> streamedVaos_;
+
+    enum OverdrawQuery
+    {
+        PREPASS_SAMPLES,
+        SHADED_SAMPLES,
+        QUERY_COUNT
+    };
+
+    GLuint queries_[QueryFrames][QUERY_COUNT];
+    bool queryPending_[QueryFrames] = {};
+    int queryFrame_ = 0;
+    float prepassSavings_ = 0.0f;
+
+    void depthPass();
+    void collectOverdrawQueries();
+    void attachInstanceStream(GLuint vao);
+    void execute(const DrawPacket& packet);
+};
@@ -0,0 +1,172 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstring>
+#include "DataContainers.hpp"
+#include "GLState.hpp"
+#include "StreamBuffer.hpp"
+
+struct CasterLightBlock
+{
+    glm::vec3 position;
+    float padding0;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff;
+    float padding1[3];
+    glm::vec3 ambient;
+    float padding2;
+    glm::vec3 diffuse;
+    float padding3;
+    glm::vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding4[2];
+};
+
+struct DirectionalLightBlock
+{
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+
+// Mirrors the std140 layout of the SceneData block declared in the shaders.
+struct SceneBlock
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float fog_density;
+    glm::vec3 skyColor;
+    float padding;
+    glm::uvec4 clusterGrid;
+    glm::vec4 clusterDepth;
+    CasterLightBlock casterLight;
+    DirectionalLightBlock directionalLight;
+    glm::mat4 casterShadow;
+};
+
+static_assert(sizeof(CasterLightBlock) == 112, "CasterLight std140 size mismatch");
+static_assert(sizeof(DirectionalLightBlock) == 64, "DirectionalLight std140 size mismatch");
+static_assert(offsetof(SceneBlock, viewPos) == 128, "SceneData std140 layout mismatch");
+static_assert(offsetof(SceneBlock, clusterGrid) == 160, "SceneData std140 layout mismatch");
+static_assert(offsetof(SceneBlock, casterLight) == 192, "SceneData std140 layout mismatch");
+static_assert(offsetof(SceneBlock, casterShadow) == 368, "SceneData std140 layout mismatch");
+
+class SceneUniformBuffer
+{
+public:
+    static const GLuint BindingPoint = 0;
+
+    // passes rendered from another viewpoint get their own copy of the block
+    enum View
+    {
+        CAMERA_VIEW,
+        CASTER_SHADOW_VIEW,
+        VIEW_COUNT
+    };
+
+    static const char* blockName()
+    {
+        return "SceneData";
+    }
+
+    SceneUniformBuffer()
+        :alignment_(uniformAlignment()),
+        stream_(GL_UNIFORM_BUFFER, VIEW_COUNT * ((sizeof(SceneBlock) + alignment_ - 1) / alignment_ * alignment_))
+    {
+    }
+
+    SceneUniformBuffer(const SceneUniformBuffer&) = delete;
+    SceneUniformBuffer& operator=(const SceneUniformBuffer&) = delete;
+
+    void setCasterLight(const CasterLight& light)
+    {
+        CasterLightBlock& b = block.casterLight;
+        b.position = light.position;
+        b.direction = light.direction;
+        b.cutOff = glm::cos(glm::radians(light.cutOff));
+        b.outerCutOff = glm::cos(glm::radians(light.outerCutOff));
+        b.ambient = light.ambient;
+        b.diffuse = light.diffuse;
+        b.specular = light.specular;
+        b.constant = light.constant;
+        b.linear = light.linear;
+        b.quadratic = light.quadratic;
+    }
+
+    void setDirectionalLight(glm::vec3 direction, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular)
+    {
+        DirectionalLightBlock& b = block.directionalLight;
+        b.direction = direction;
+        b.ambient = ambient;
+        b.diffuse = diffuse;
+        b.specular = specular;
+    }
+
+    void setView(View view, const glm::mat4& projection, const glm::mat4& viewMatrix, const glm::vec3& position)
+    {
+        views_[view] = SceneView{ projection, viewMatrix, position };
+    }
+
+    void upload()
+    {
+        stream_.beginFrame();
+        for (int view = 0; view < VIEW_COUNT; ++view)
+        {
+            SceneBlock* data = static_cast<SceneBlock*>(stream_.allocate(sizeof(SceneBlock), alignment_, offsets_[view]));
+            if (!data)
+                return;
+
+            std::memcpy(data, &block, sizeof(SceneBlock));
+            if (view != CAMERA_VIEW)
+            {
+                data->projection = views_[view].projection;
+                data->view = views_[view].view;
+                data->viewPos = views_[view].position;
+            }
+        }
+        stream_.finishWrites();
+        bind(CAMERA_VIEW);
+    }
+
+    void bind(View view)
+    {
+        GLState::bindBufferRange(GL_UNIFORM_BUFFER, BindingPoint, stream_.getBuffer(), offsets_[view], sizeof(SceneBlock));
+    }
+
+    void endFrame()
+    {
+        stream_.endFrame();
+    }
+
+    SceneBlock block = {};
+
+private:
+    struct SceneView
+    {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec3 position;
+    };
+
+    GLsizeiptr alignment_;
+    StreamBuffer stream_;
+    SceneView views_[VIEW_COUNT] = {};
+    GLintptr offsets_[VIEW_COUNT] = {};
+
+    static GLsizeiptr uniformAlignment()
+    {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        return alignment > 0 ? alignment : 256;
+    }
+};
@@ -1,53 +1,160 @@
 #include "Shader.hpp"
+#include "ProgramBinaryCache.hpp"
+#include "ShaderCompiler.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <cstring>
 
-    Shader::Shader(const char* vertexPath, const char* fragmentPath)
+    Shader::Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines)
     {
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
+        std::string vertexCode = preprocess(vertexPath, defines, vertexFiles_);
+        std::string fragmentCode = preprocess(fragmentPath, defines, fragmentFiles_);
+        cacheKey_ = ProgramBinaryCache::makeKey(vertexCode, fragmentCode);
+
+        id_ = glCreateProgram();
+        if (ProgramBinaryCache::load(id_, cacheKey_))
         {
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            vShaderFile.close();
-            fShaderFile.close();
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            reflectUniforms();
+            return;
         }
-        catch (std::ifstream::failure& e)
+
+        pending_ = true;
+        ShaderCompiler* compiler = ShaderCompiler::current();
+        if (compiler && compiler->getMode() == ShaderCompiler::WORKER_CONTEXT)
+            task_ = compiler->enqueue([this, vertexCode, fragmentCode]() { compileAndLink(vertexCode, fragmentCode); });
+        else
+            compileAndLink(vertexCode, fragmentCode);
+
+        if (!compiler)
+            finalize();
+    }
+
+    Shader::Shader(const char* computePath, const ShaderDefines& defines)
+    {
+        std::string computeCode = preprocess(computePath, defines, computeFiles_);
+        cacheKey_ = ProgramBinaryCache::makeKey(computeCode, std::string());
+
+        id_ = glCreateProgram();
+        if (ProgramBinaryCache::load(id_, cacheKey_))
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            reflectUniforms();
+            return;
         }
+
+        pending_ = true;
+        ShaderCompiler* compiler = ShaderCompiler::current();
+        if (compiler && compiler->getMode() == ShaderCompiler::WORKER_CONTEXT)
+            task_ = compiler->enqueue([this, computeCode]() { compileAndLinkCompute(computeCode); });
+        else
+            compileAndLinkCompute(computeCode);
+
+        if (!compiler)
+            finalize();
+    }
+
+    void Shader::compileAndLink(const std::string& vertexCode, const std::string& fragmentCode)
+    {
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
 
-        unsigned int vertex, fragment;
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, false);
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, false);
-        id_ = glCreateProgram();
-        glAttachShader(id_, vertex);
-        glAttachShader(id_, fragment);
+        vertex_ = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex_, 1, &vShaderCode, NULL);
+        glCompileShader(vertex_);
+        fragment_ = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment_, 1, &fShaderCode, NULL);
+        glCompileShader(fragment_);
+        glAttachShader(id_, vertex_);
+        glAttachShader(id_, fragment_);
+        glProgramParameteri(id_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(id_);
-        checkCompileErrors(id_, true);
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+    }
+
+    void Shader::compileAndLinkCompute(const std::string& computeCode)
+    {
+        const char* cShaderCode = computeCode.c_str();
+
+        compute_ = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute_, 1, &cShaderCode, NULL);
+        glCompileShader(compute_);
+        glAttachShader(id_, compute_);
+        glProgramParameteri(id_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(id_);
+    }
+
+    void Shader::checkStage(unsigned int shader, const std::vector<std::string>& files)
+    {
+        if (shader && !checkCompileErrors(shader, false))
+            printSourceFiles(files);
+    }
+
+    void Shader::releaseStage(unsigned int& shader, std::vector<std::string>& files)
+    {
+        if (shader)
+        {
+            glDetachShader(id_, shader);
+            glDeleteShader(shader);
+            shader = 0;
+        }
+        files.clear();
+    }
+
+    bool Shader::isReady() const
+    {
+        if (!pending_)
+            return true;
+        if (task_)
+            return task_->load();
+
+        ShaderCompiler* compiler = ShaderCompiler::current();
+        if (compiler && compiler->getMode() == ShaderCompiler::PARALLEL_EXTENSION)
+        {
+            GLint completed = GL_FALSE;
+            glGetProgramiv(id_, GL_COMPLETION_STATUS_KHR, &completed);
+            return completed == GL_TRUE;
+        }
+        return true;
+    }
+
+    void Shader::finalize()
+    {
+        if (!pending_)
+            return;
+
+        if (task_ && !task_->load())
+            ShaderCompiler::current()->wait(task_);
+
+        checkStage(vertex_, vertexFiles_);
+        checkStage(fragment_, fragmentFiles_);
+        checkStage(compute_, computeFiles_);
+        if (checkCompileErrors(id_, true))
+            ProgramBinaryCache::store(id_, cacheKey_);
+
+        releaseStage(vertex_, vertexFiles_);
+        releaseStage(fragment_, fragmentFiles_);
+        releaseStage(compute_, computeFiles_);
+        task_.reset();
+        pending_ = false;
+
+        reflectUniforms();
+        for (auto& block : pendingBlocks_)
+            bindUniformBlock(block.first, block.second);
+        pendingBlocks_.clear();
+        for (auto& sampler : pendingSamplers_)
+            bindSampler(sampler.first, sampler.second);
+        pendingSamplers_.clear();
     }
 
     Shader::~Shader()
     {
-        glDeleteProgram(id_);
+        if (task_ && !task_->load())
+            ShaderCompiler::current()->wait(task_);
+        if (pending_)
+        {
+            glDeleteShader(vertex_);
+            glDeleteShader(fragment_);
+            glDeleteShader(compute_);
+        }
+        GLState::deleteProgram(id_);
     }
 
     unsigned Shader::getId() const
@@ -55,38 +162,186 @@
         return id_;
     }
 
-    void Shader::use() const
+    void Shader::use()
     {
-        glUseProgram(id_);
+        finalize();
+        GLState::useProgram(id_);
     }
 
-    void Shader::setBool(const std::string& name, bool value) const
+    void Shader::bindUniformBlock(const std::string& name, GLuint binding)
     {
-        glUniform1i(glGetUniformLocation(id_, name.c_str()), static_cast<int>(value));
+        if (pending_)
+        {
+            pendingBlocks_.emplace_back(name, binding);
+            return;
+        }
+
+        GLuint index = glGetUniformBlockIndex(id_, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(id_, index, binding);
     }
 
-    void Shader::setInt(const std::string& name, int value) const
+    void Shader::bindSampler(const std::string& name, GLint unit)
     {
-        glUniform1i(glGetUniformLocation(id_, name.c_str()), value);
+        if (pending_)
+        {
+            pendingSamplers_.emplace_back(name, unit);
+            return;
+        }
+
+        int index = findUniform(name, GL_INT);
+        if (updateShadow(index, &unit, sizeof(unit)))
+            glProgramUniform1i(id_, uniforms_[index].location, unit);
     }
 
-    void Shader::setFloat(const std::string& name, float value) const
+    const std::vector<UniformInfo>& Shader::getUniforms() const
     {
-        glUniform1f(glGetUniformLocation(id_, name.c_str()), value);
+        return uniforms_;
     }
 
-    void Shader::setMat4(const std::string& name, glm::mat4 value) const
+    void Shader::set(Uniform<bool> uniform, bool value)
     {
-        glUniformMatrix4fv(glGetUniformLocation(id_, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+        int v = static_cast<int>(value);
+        if (updateShadow(uniform.index, &v, sizeof(v)))
+            glUniform1i(uniforms_[uniform.index].location, v);
     }
 
-    void Shader::setVec3(const std::string& name, glm::vec3 value) const
+    void Shader::set(Uniform<int> uniform, int value)
     {
-        glUniform3fv(glGetUniformLocation(id_, name.c_str()), 1, &value[0]);
+        if (updateShadow(uniform.index, &value, sizeof(value)))
+            glUniform1i(uniforms_[uniform.index].location, value);
     }
 
+    void Shader::set(Uniform<float> uniform, float value)
+    {
+        if (updateShadow(uniform.index, &value, sizeof(value)))
+            glUniform1f(uniforms_[uniform.index].location, value);
+    }
+
+    void Shader::set(Uniform<glm::vec2> uniform, const glm::vec2& value)
+    {
+        if (updateShadow(uniform.index, glm::value_ptr(value), sizeof(value)))
+            glUniform2fv(uniforms_[uniform.index].location, 1, glm::value_ptr(value));
+    }
+
+    void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3& value)
+    {
+        if (updateShadow(uniform.index, glm::value_ptr(value), sizeof(value)))
+            glUniform3fv(uniforms_[uniform.index].location, 1, glm::value_ptr(value));
+    }
+
+    void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4& value)
+    {
+        if (updateShadow(uniform.index, glm::value_ptr(value), sizeof(value)))
+            glUniformMatrix4fv(uniforms_[uniform.index].location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+
+    void Shader::setBool(const std::string& name, bool value)
+    {
+        set(getUniform<bool>(name), value);
+    }
+
+    void Shader::setInt(const std::string& name, int value)
+    {
+        set(getUniform<int>(name), value);
+    }
 
-    void Shader::checkCompileErrors(unsigned int shader, bool checkProgramCompilationStatus)
+    void Shader::setFloat(const std::string& name, float value)
+    {
+        set(getUniform<float>(name), value);
+    }
+
+    void Shader::setMat4(const std::string& name, glm::mat4 value)
+    {
+        set(getUniform<glm::mat4>(name), value);
+    }
+
+    void Shader::setVec2(const std::string& name, glm::vec2 value)
+    {
+        set(getUniform<glm::vec2>(name), value);
+    }
+
+    void Shader::setVec3(const std::string& name, glm::vec3 value)
+    {
+        set(getUniform<glm::vec3>(name), value);
+    }
+
+    void Shader::reflectUniforms()
+    {
+        uniforms_.clear();
+        uniformIndices_.clear();
+
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(id_, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> buffer(std::max(maxLength, 1));
+
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(id_, static_cast<GLuint>(i), maxLength, nullptr, &size, &type, buffer.data());
+            std::string name = buffer.data();
+
+            GLint location = glGetUniformLocation(id_, name.c_str());
+            if (location < 0)
+                continue;
+
+            std::string base = name;
+            bool isArray = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0;
+            if (isArray)
+                base = name.substr(0, name.size() - 3);
+
+            for (GLint element = 0; element < size; ++element)
+            {
+                UniformInfo info;
+                info.name = isArray ? base + "[" + std::to_string(element) + "]" : name;
+                info.type = type;
+                info.location = element == 0 ? location : glGetUniformLocation(id_, info.name.c_str());
+                info.size = element == 0 ? size : 1;
+                info.assigned = false;
+
+                uniformIndices_[info.name] = static_cast<int>(uniforms_.size());
+                uniforms_.push_back(info);
+            }
+
+            if (isArray)
+                uniformIndices_[base] = uniformIndices_[name];
+        }
+    }
+
+    int Shader::findUniform(const std::string& name, GLenum type) const
+    {
+        auto it = uniformIndices_.find(name);
+        if (it == uniformIndices_.end())
+            return -1;
+
+        GLenum actual = uniforms_[it->second].type;
+        bool isSampler = actual == GL_SAMPLER_2D || actual == GL_SAMPLER_CUBE || actual == GL_SAMPLER_2D_SHADOW ||
+                         actual == GL_SAMPLER_2D_ARRAY;
+        if (actual != type && !(type == GL_INT && isSampler))
+        {
+            std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH: " << name << std::endl;
+            return -1;
+        }
+        return it->second;
+    }
+
+    bool Shader::updateShadow(int index, const void* value, size_t size)
+    {
+        if (index < 0)
+            return false;
+
+        UniformInfo& info = uniforms_[index];
+        if (info.assigned && std::memcmp(info.value, value, size) == 0)
+            return false;
+
+        std::memcpy(info.value, value, size);
+        info.assigned = true;
+        return true;
+    }
+
+    bool Shader::checkCompileErrors(unsigned int shader, bool checkProgramCompilationStatus)
     {
         int success;
         char infoLog[1024];
@@ -108,4 +363,89 @@
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR\n" << infoLog << std::endl;
             }
         }
+        return success != 0;
+    }
+
+    std::string Shader::readFile(const std::string& path)
+    {
+        std::ifstream file;
+        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            file.close();
+            return stream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << " " << e.what() << std::endl;
+        }
+        return std::string();
+    }
+
+    std::string Shader::preprocess(const std::string& path, const ShaderDefines& defines, std::vector<std::string>& files)
+    {
+        std::string source = expandIncludes(path, files);
+
+        std::string header;
+        for (auto& define : defines)
+            header += "#define " + define.first + " " + define.second + "\n";
+        header += "#line 2 0\n";
+
+        size_t versionEnd = 0;
+        if (source.compare(0, 8, "#version") == 0)
+            versionEnd = source.find('\n') + 1;
+        source.insert(versionEnd, header);
+        return source;
+    }
+
+    std::string Shader::expandIncludes(const std::string& path, std::vector<std::string>& files)
+    {
+        const int fileIndex = static_cast<int>(files.size());
+        files.push_back(path);
+
+        std::string directory;
+        size_t slash = path.find_last_of("/\\");
+        if (slash != std::string::npos)
+            directory = path.substr(0, slash + 1);
+
+        std::istringstream stream(readFile(path));
+        std::string result, line;
+        int lineNumber = 0;
+        while (std::getline(stream, line))
+        {
+            ++lineNumber;
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+            {
+                result += line + "\n";
+                continue;
+            }
+
+            size_t open = line.find('"', start);
+            size_t close = line.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos)
+            {
+                std::cout << "ERROR::SHADER::INVALID_INCLUDE: " << path << ":" << lineNumber << std::endl;
+                result += "\n";
+                continue;
+            }
+
+            std::string includePath = directory + line.substr(open + 1, close - open - 1);
+            if (std::find(files.begin(), files.end(), includePath) == files.end())
+            {
+                result += "#line 1 " + std::to_string(files.size()) + "\n";
+                result += expandIncludes(includePath, files);
+            }
+            result += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+        }
+        return result;
+    }
+
+    void Shader::printSourceFiles(const std::vector<std::string>& files)
+    {
+        for (size_t i = 0; i < files.size(); ++i)
+            std::cout << "  " << i << ": " << files[i] << std::endl;
     }
\ No newline at end of file
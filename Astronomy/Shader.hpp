@@ -5,27 +5,107 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+struct UniformInfo
+{
+    std::string name;
+    GLenum type;
+    GLint location;
+    GLint size;
+    bool assigned;
+    GLfloat value[16];
+};
+
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
 class Shader
 {
 public:
-    Shader(const char* vertexPath, const char* fragmentPath);
+    template<typename T>
+    struct Uniform
+    {
+        int index = -1;
+    };
+
+    Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines());
+    explicit Shader(const char* computePath, const ShaderDefines& defines = ShaderDefines());
     ~Shader();
 
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
     unsigned int getId() const;
+    const std::vector<UniformInfo>& getUniforms() const;
 
-    void use() const;
-    void setBool(const std::string& name, bool value) const;
-    void setInt(const std::string& name, int value) const;
-    void setFloat(const std::string& name, float value) const;
-    void setVec3(const std::string& name, glm::vec3 value) const;
-    void setMat4(const std::string& name, glm::mat4 value) const;
+    template<typename T>
+    Uniform<T> getUniform(const std::string& name)
+    {
+        finalize();
+        return Uniform<T>{ findUniform(name, glType<T>()) };
+    }
+
+    bool isReady() const;
+    void finalize();
+    void use();
+    void bindUniformBlock(const std::string& name, GLuint binding);
+    void bindSampler(const std::string& name, GLint unit);
+    void set(Uniform<bool> uniform, bool value);
+    void set(Uniform<int> uniform, int value);
+    void set(Uniform<float> uniform, float value);
+    void set(Uniform<glm::vec2> uniform, const glm::vec2& value);
+    void set(Uniform<glm::vec3> uniform, const glm::vec3& value);
+    void set(Uniform<glm::mat4> uniform, const glm::mat4& value);
+
+    void setBool(const std::string& name, bool value);
+    void setInt(const std::string& name, int value);
+    void setFloat(const std::string& name, float value);
+    void setVec2(const std::string& name, glm::vec2 value);
+    void setVec3(const std::string& name, glm::vec3 value);
+    void setMat4(const std::string& name, glm::mat4 value);
 
 private:
     unsigned int id_;
-    static void checkCompileErrors(unsigned int shader, bool checkProgramCompilationStatus);
+    unsigned int vertex_ = 0;
+    unsigned int fragment_ = 0;
+    unsigned int compute_ = 0;
+    uint64_t cacheKey_ = 0;
+    bool pending_ = false;
+    std::shared_ptr<std::atomic<bool>> task_;
+    std::vector<std::string> vertexFiles_, fragmentFiles_, computeFiles_;
+    std::vector<std::pair<std::string, GLuint>> pendingBlocks_;
+    std::vector<std::pair<std::string, GLint>> pendingSamplers_;
+    std::vector<UniformInfo> uniforms_;
+    std::unordered_map<std::string, int> uniformIndices_;
+
+    void compileAndLink(const std::string& vertexCode, const std::string& fragmentCode);
+    void compileAndLinkCompute(const std::string& computeCode);
+    void releaseStage(unsigned int& shader, std::vector<std::string>& files);
+    static void checkStage(unsigned int shader, const std::vector<std::string>& files);
+    void reflectUniforms();
+    int findUniform(const std::string& name, GLenum type) const;
+    bool updateShadow(int index, const void* value, size_t size);
+    static bool checkCompileErrors(unsigned int shader, bool checkProgramCompilationStatus);
+    static std::string readFile(const std::string& path);
+    static std::string preprocess(const std::string& path, const ShaderDefines& defines, std::vector<std::string>& files);
+    static std::string expandIncludes(const std::string& path, std::vector<std::string>& files);
+    static void printSourceFiles(const std::vector<std::string>& files);
+
+    template<typename T> static GLenum glType();
 };
+
+template<> inline GLenum Shader::glType<bool>() { return GL_BOOL; }
+template<> inline GLenum Shader::glType<int>() { return GL_INT; }
+template<> inline GLenum Shader::glType<float>() { return GL_FLOAT; }
+template<> inline GLenum Shader::glType<glm::vec2>() { return GL_FLOAT_VEC2; }
+template<> inline GLenum Shader::glType<glm::vec3>() { return GL_FLOAT_VEC3; }
+template<> inline GLenum Shader::glType<glm::mat4>() { return GL_FLOAT_MAT4; }
@@ -0,0 +1,115 @@
+#include "ShaderCompiler.hpp"
+#include <iostream>
+
+ShaderCompiler* ShaderCompiler::current_ = nullptr;
+
+ShaderCompiler::ShaderCompiler(GLFWwindow* window)
+    :mode_(SYNCHRONOUS)
+{
+    const char* extensions[] = { "GL_KHR_parallel_shader_compile", "GL_ARB_parallel_shader_compile" };
+    const char* functions[] = { "glMaxShaderCompilerThreadsKHR", "glMaxShaderCompilerThreadsARB" };
+    for (int i = 0; i < 2 && mode_ == SYNCHRONOUS; ++i)
+    {
+        if (!glfwExtensionSupported(extensions[i]))
+            continue;
+        auto maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(glfwGetProcAddress(functions[i]));
+        if (maxThreads)
+            maxThreads(0xFFFFFFFF);
+        mode_ = PARALLEL_EXTENSION;
+    }
+
+    if (mode_ == SYNCHRONOUS && window)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        worker_window_ = glfwCreateWindow(1, 1, "", nullptr, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+        if (worker_window_)
+        {
+            mode_ = WORKER_CONTEXT;
+            worker_ = std::thread(&ShaderCompiler::workerLoop, this);
+        }
+        else
+            std::cout << "WARNING::SHADER_COMPILER::NO_WORKER_CONTEXT, compiling synchronously" << std::endl;
+    }
+
+    current_ = this;
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+    if (worker_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        queue_changed_.notify_all();
+        worker_.join();
+    }
+    if (worker_window_)
+        glfwDestroyWindow(worker_window_);
+
+    if (current_ == this)
+        current_ = nullptr;
+}
+
+ShaderCompiler* ShaderCompiler::current()
+{
+    return current_;
+}
+
+ShaderCompiler::Mode ShaderCompiler::getMode() const
+{
+    return mode_;
+}
+
+CompileTask ShaderCompiler::enqueue(std::function<void()> job)
+{
+    CompileTask task = std::make_shared<std::atomic<bool>>(false);
+    if (mode_ != WORKER_CONTEXT)
+    {
+        job();
+        task->store(true);
+        return task;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.emplace_back(std::move(job), task);
+    }
+    queue_changed_.notify_one();
+    return task;
+}
+
+void ShaderCompiler::wait(const CompileTask& task)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_finished_.wait(lock, [&task]() { return task->load(); });
+}
+
+void ShaderCompiler::workerLoop()
+{
+    glfwMakeContextCurrent(worker_window_);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        queue_changed_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+        if (queue_.empty())
+            break;
+
+        auto job = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        job.first();
+        glFinish();
+
+        lock.lock();
+        job.second->store(true);
+        task_finished_.notify_all();
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
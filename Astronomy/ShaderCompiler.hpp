@@ -0,0 +1,55 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef std::shared_ptr<std::atomic<bool>> CompileTask;
+
+class ShaderCompiler
+{
+public:
+    enum Mode
+    {
+        PARALLEL_EXTENSION,
+        WORKER_CONTEXT,
+        SYNCHRONOUS,
+    };
+
+    explicit ShaderCompiler(GLFWwindow* window);
+    ~ShaderCompiler();
+
+    ShaderCompiler(const ShaderCompiler&) = delete;
+    ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+    static ShaderCompiler* current();
+
+    Mode getMode() const;
+    CompileTask enqueue(std::function<void()> job);
+    void wait(const CompileTask& task);
+
+private:
+    typedef void (*MaxShaderCompilerThreadsProc)(GLuint count);
+
+    static ShaderCompiler* current_;
+
+    Mode mode_;
+    GLFWwindow* worker_window_ = nullptr;
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable queue_changed_;
+    std::condition_variable task_finished_;
+    std::deque<std::pair<std::function<void()>, CompileTask>> queue_;
+    bool stopping_ = false;
+
+    void workerLoop();
+};
@@ -0,0 +1,169 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Shader.hpp"
+#include "DataContainers.hpp"
+#include "Material.hpp"
+#include "LightingCache.hpp"
+
+struct ShaderPermutation
+{
+    enum Object
+    {
+        SPHERE = 0,
+        ASTEROID = 1,
+        SPACESHIP = 2,
+        SPHERE_IMPOSTOR = 3,
+    };
+
+    ShaderPermutation(Object object, bool gouraud = false, bool blinn = false, bool star = false, bool fallback = false,
+                      bool depthOnly = false, bool lightingCache = false)
+        :object(object), gouraud(gouraud), blinn(blinn), star(star), fallback(fallback), depthOnly(depthOnly),
+        lightingCache(lightingCache)
+    {
+    }
+
+    Object object;
+    bool gouraud;
+    bool blinn;
+    bool star;
+    bool fallback;
+    bool depthOnly;
+    bool lightingCache;
+
+    unsigned int key() const
+    {
+        return static_cast<unsigned int>(object)
+            | static_cast<unsigned int>(gouraud) << 8
+            | static_cast<unsigned int>(blinn) << 9
+            | static_cast<unsigned int>(star) << 10
+            | static_cast<unsigned int>(fallback) << 11
+            | static_cast<unsigned int>(depthOnly) << 12
+            | static_cast<unsigned int>(lightingCache) << 13;
+    }
+
+    // keeps every flag except the lighting model, which the unlit fallback never evaluates
+    ShaderPermutation getFallback() const
+    {
+        ShaderPermutation permutation = *this;
+        permutation.fallback = true;
+        permutation.gouraud = false;
+        permutation.blinn = false;
+        return permutation;
+    }
+
+    static ShaderPermutation depthPass(Object object)
+    {
+        return ShaderPermutation(object, false, false, false, false, true);
+    }
+};
+
+class ShadersPack
+{
+public:
+    Shader& get(const ShaderPermutation& permutation)
+    {
+        Shader& shader = program(permutation);
+        shader.finalize();
+        return shader;
+    }
+
+    Shader& acquire(const ShaderPermutation& permutation)
+    {
+        Shader& shader = program(permutation);
+        if (shader.isReady() || permutation.fallback)
+            return shader;
+
+        return get(permutation.getFallback());
+    }
+
+    void prefetch(const ShaderPermutation& permutation)
+    {
+        program(permutation.getFallback());
+        program(permutation);
+    }
+
+    void bindUniformBlock(const char* name, GLuint binding)
+    {
+        uniformBlocks_.emplace_back(name, binding);
+        for (auto& program : programs_)
+            program.second->bindUniformBlock(name, binding);
+    }
+
+    void bindSampler(const char* name, GLint unit)
+    {
+        samplers_.emplace_back(name, unit);
+        for (auto& program : programs_)
+            program.second->bindSampler(name, unit);
+    }
+
+private:
+    std::unordered_map<unsigned int, std::unique_ptr<Shader>> programs_;
+
+    Shader& program(const ShaderPermutation& permutation)
+    {
+        unsigned int key = permutation.key();
+        auto it = programs_.find(key);
+        if (it != programs_.end())
+            return *it->second;
+
+        bool impostor = permutation.object == ShaderPermutation::SPHERE_IMPOSTOR;
+        std::unique_ptr<Shader> shader(new Shader(impostor ? "impostor.vert" : "object.vert",
+                                                  impostor ? "impostor.frag" : "object.frag",
+                                                  definesFor(permutation)));
+        for (auto& block : uniformBlocks_)
+            shader->bindUniformBlock(block.first, block.second);
+        for (auto& sampler : Material::samplerBindings())
+            shader->bindSampler(sampler.first, sampler.second);
+        for (auto& sampler : samplers_)
+            shader->bindSampler(sampler.first, sampler.second);
+
+        Shader& result = *shader;
+        programs_.emplace(key, std::move(shader));
+        return result;
+    }
+    std::vector<std::pair<std::string, GLuint>> uniformBlocks_;
+    std::vector<std::pair<std::string, GLint>> samplers_;
+
+    static ShaderDefines definesFor(const ShaderPermutation& permutation)
+    {
+        ShaderDefines defines;
+        if (permutation.gouraud)
+            defines.emplace_back("GOURAUD", "");
+        if (permutation.blinn)
+            defines.emplace_back("BLINN", "");
+        if (permutation.star)
+            defines.emplace_back("STAR", "");
+        if (permutation.fallback)
+            defines.emplace_back("FALLBACK", "");
+        if (permutation.depthOnly)
+            defines.emplace_back("DEPTH_ONLY", "");
+        if (permutation.lightingCache)
+            for (auto& define : LightingCache::defines())
+                defines.push_back(define);
+
+        std::string shininess;
+        switch (permutation.object)
+        {
+        case ShaderPermutation::SPHERE:
+            defines.emplace_back("SPHERE", "");
+            shininess = permutation.gouraud ? "16.0" : "8.0";
+            break;
+        case ShaderPermutation::ASTEROID:
+            shininess = "16.0";
+            break;
+        case ShaderPermutation::SPHERE_IMPOSTOR:
+            shininess = "8.0";
+            break;
+        case ShaderPermutation::SPACESHIP:
+            defines.emplace_back("TEXTURED", "");
+            shininess = "8.0";
+            break;
+        }
+        defines.emplace_back("SHININESS", shininess);
+        return defines;
+    }
+};
@@ -0,0 +1,29 @@
+#include "ShadingLod.hpp"
+#include <glm/gtc/constants.hpp>
+
+bool ShadingLod::selectGouraud(bool gouraud, float projectedRadius)
+{
+    float threshold = GouraudMaxRadius * (gouraud ? 1.0f + Hysteresis : 1.0f - Hysteresis);
+    return projectedRadius < threshold;
+}
+
+void ShadingLod::beginFrame()
+{
+    totalSaved_ += frameSaved_;
+    frameSaved_ = 0.0;
+}
+
+void ShadingLod::addSaved(float projectedRadius)
+{
+    frameSaved_ += glm::pi<double>() * projectedRadius * projectedRadius;
+}
+
+uint64_t ShadingLod::getFrameSaved() const
+{
+    return static_cast<uint64_t>(frameSaved_);
+}
+
+uint64_t ShadingLod::getTotalSaved() const
+{
+    return static_cast<uint64_t>(totalSaved_ + frameSaved_);
+}
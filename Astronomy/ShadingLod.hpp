@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+
+// Per-object choice between the Gouraud and Phong programs by projected size.
+// Objects smaller than GouraudMaxRadius pixels are lit per vertex; Hysteresis keeps them from flickering at the edge.
+class ShadingLod
+{
+public:
+    static constexpr float GouraudMaxRadius = 16.0f;
+    static constexpr float Hysteresis = 0.2f;
+
+    static bool selectGouraud(bool gouraud, float projectedRadius);
+
+    void beginFrame();
+    // a visible object of this projected radius was lit per vertex, sparing roughly its covered pixels
+    void addSaved(float projectedRadius);
+
+    uint64_t getFrameSaved() const;
+    uint64_t getTotalSaved() const;
+
+private:
+    double frameSaved_ = 0.0;
+    double totalSaved_ = 0.0;
+};
@@ -0,0 +1,172 @@
+#include "ShadowMap.hpp"
+#include "GLState.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    const float PolygonOffsetFactor = 2.0f;
+    const float PolygonOffsetUnits = 4.0f;
+}
+
+const char* ShadowMap::updateName(Update update)
+{
+    switch (update)
+    {
+    case DYNAMIC_LAYER: return "DYNAMIC";
+    case ALL_LAYERS: return "ALL";
+    default: return "CACHED";
+    }
+}
+
+ShadowMap::ShadowMap()
+    :staticDepth_(createDepthTexture(false)), depth_(createDepthTexture(true)),
+    staticFramebuffer_(createFramebuffer(staticDepth_)), framebuffer_(createFramebuffer(depth_))
+{
+}
+
+ShadowMap::~ShadowMap()
+{
+    glDeleteFramebuffers(1, &staticFramebuffer_);
+    glDeleteFramebuffers(1, &framebuffer_);
+    GLState::deleteTexture(staticDepth_);
+    GLState::deleteTexture(depth_);
+}
+
+void ShadowMap::setLight(const CasterLight& light)
+{
+    glm::vec3 direction = glm::normalize(light.direction);
+    if (light.outerCutOff == outerCutOff_ && glm::distance(light.position, position_) < PositionThreshold &&
+        glm::dot(direction, direction_) > std::cos(glm::radians(AngleThreshold)))
+        return;
+
+    glm::vec3 up = glm::abs(direction.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    float fov = 2.0f * (light.outerCutOff + 2.0f * AngleThreshold);
+    view_ = glm::lookAt(light.position, light.position + direction, up);
+    projection_ = glm::perspective(glm::radians(fov), 1.0f, NearPlane, FarPlane);
+    position_ = light.position;
+    direction_ = direction;
+    outerCutOff_ = light.outerCutOff;
+    frustum_ = Frustum::fromMatrix(projection_ * view_);
+    staticDirty_ = true;
+}
+
+bool ShadowMap::needsUpdate(const std::vector<IDrawable*>& drawables)
+{
+    bool casterMoved = false;
+    for (IDrawable* drawable : drawables)
+        if (drawable->ShadowCastersMoved(frustum_))
+            casterMoved = true;
+
+    update_ = staticDirty_ ? ALL_LAYERS : casterMoved ? DYNAMIC_LAYER : CACHED;
+    return update_ != CACHED;
+}
+
+void ShadowMap::render(const std::vector<IDrawable*>& drawables, RenderQueue& queue, const RenderContext& context)
+{
+    glViewport(0, 0, Resolution, Resolution);
+    GLState::setEnabled(GL_POLYGON_OFFSET_FILL, true);
+    glPolygonOffset(PolygonOffsetFactor, PolygonOffsetUnits);
+
+    if (update_ == ALL_LAYERS)
+    {
+        drawLayer(staticFramebuffer_, STATIC_CASTERS, drawables, queue, context);
+        staticDirty_ = false;
+    }
+    glCopyImageSubData(staticDepth_, GL_TEXTURE_2D, 0, 0, 0, 0, depth_, GL_TEXTURE_2D, 0, 0, 0, 0, Resolution, Resolution, 1);
+    drawLayer(framebuffer_, DYNAMIC_CASTERS, drawables, queue, context);
+
+    GLState::setEnabled(GL_POLYGON_OFFSET_FILL, false);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowMap::drawLayer(GLuint framebuffer, ShadowLayer layer, const std::vector<IDrawable*>& drawables,
+                          RenderQueue& queue, const RenderContext& context)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (layer == STATIC_CASTERS)
+    {
+        GLState::depthMask(GL_TRUE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    for (IDrawable* drawable : drawables)
+        drawable->SubmitShadow(queue, context, layer);
+    queue.flushDepth();
+}
+
+void ShadowMap::bind() const
+{
+    GLState::bindTexture(TextureUnit, GL_TEXTURE_2D, depth_);
+}
+
+const glm::mat4& ShadowMap::getView() const
+{
+    return view_;
+}
+
+const glm::mat4& ShadowMap::getProjection() const
+{
+    return projection_;
+}
+
+const glm::vec3& ShadowMap::getPosition() const
+{
+    return position_;
+}
+
+const Frustum& ShadowMap::getFrustum() const
+{
+    return frustum_;
+}
+
+float ShadowMap::getPixelScale() const
+{
+    return 0.5f * projection_[1][1] * Resolution;
+}
+
+// world space to shadow map texture coordinates and depth
+glm::mat4 ShadowMap::getShadowMatrix() const
+{
+    glm::mat4 bias = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+    return bias * projection_ * view_;
+}
+
+ShadowMap::Update ShadowMap::getLastUpdate() const
+{
+    return update_;
+}
+
+GLuint ShadowMap::createDepthTexture(bool compare)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GLState::bindTexture(TextureUnit, GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, Resolution, Resolution);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    const float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+    if (compare)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+    return texture;
+}
+
+GLuint ShadowMap::createFramebuffer(GLuint depth)
+{
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::SHADOW_MAP::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return framebuffer;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "DataContainers.hpp"
+#include "IDrawable.hpp"
+#include "Material.hpp"
+
+// Spot-light shadow map cached in two layers. Static casters are redrawn only when the light drifts past the
+// thresholds below; dynamic casters are redrawn over a copy of the static layer when one of them moves inside
+// the light's frustum.
+class ShadowMap
+{
+public:
+    static const GLsizei Resolution = 1024;
+    static const GLuint TextureUnit = Material::SLOT_COUNT * Material::UnitsPerSlot;
+    static constexpr float NearPlane = 0.1f;
+    static constexpr float FarPlane = 100.0f;
+    // the map keeps the view it was rendered from until the light moves or turns this much;
+    // its frustum is wider than the light's cone by twice the angle so the cone stays covered meanwhile
+    static constexpr float PositionThreshold = 0.05f;
+    static constexpr float AngleThreshold = 1.0f;
+
+    enum Update
+    {
+        CACHED,
+        DYNAMIC_LAYER,
+        ALL_LAYERS
+    };
+
+    static const char* samplerName()
+    {
+        return "casterShadowMap";
+    }
+
+    static const char* updateName(Update update);
+
+    ShadowMap();
+    ~ShadowMap();
+
+    ShadowMap(const ShadowMap&) = delete;
+    ShadowMap& operator=(const ShadowMap&) = delete;
+
+    void setLight(const CasterLight& light);
+    bool needsUpdate(const std::vector<IDrawable*>& drawables);
+    // expects the SceneData block to hold the light's view; leaves the default framebuffer bound
+    void render(const std::vector<IDrawable*>& drawables, RenderQueue& queue, const RenderContext& context);
+    void bind() const;
+
+    const glm::mat4& getView() const;
+    const glm::mat4& getProjection() const;
+    const glm::vec3& getPosition() const;
+    const Frustum& getFrustum() const;
+    float getPixelScale() const;
+    glm::mat4 getShadowMatrix() const;
+    Update getLastUpdate() const;
+
+private:
+    GLuint staticDepth_, depth_;
+    GLuint staticFramebuffer_, framebuffer_;
+    glm::mat4 view_ = glm::mat4(0.0f);
+    glm::mat4 projection_ = glm::mat4(0.0f);
+    glm::vec3 position_ = glm::vec3(0.0f);
+    glm::vec3 direction_ = glm::vec3(0.0f);
+    float outerCutOff_ = 0.0f;
+    Frustum frustum_ = {};
+    bool staticDirty_ = true;
+    Update update_ = CACHED;
+
+    void drawLayer(GLuint framebuffer, ShadowLayer layer, const std::vector<IDrawable*>& drawables,
+                   RenderQueue& queue, const RenderContext& context);
+    static GLuint createDepthTexture(bool compare);
+    static GLuint createFramebuffer(GLuint depth);
+};
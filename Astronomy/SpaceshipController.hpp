@@ -77,7 +77,43 @@ public:
         }
     }
 
-    void Draw(Shader& shader) override
+    void Submit(RenderQueue& queue, const RenderContext& context) override
+    {
+        const Frustum* frustum = context.colors.culling == NO_CULLING ? nullptr : &context.frustum;
+        glm::mat4 transform = getTransform();
+        Shader* shader = &context.shader(ShaderPermutation::SPACESHIP);
+        if (context.colors.shadingLod)
+        {
+            glm::vec4 bounds = getBounds(transform);
+            float radius = context.projectedRadius(glm::vec3(bounds), bounds.w);
+            gouraud_ = ShadingLod::selectGouraud(gouraud_, radius);
+            if (gouraud_ && context.frustum.intersects(bounds))
+                context.shadingLod->addSaved(radius);
+            shader = &context.lodShader(ShaderPermutation::SPACESHIP, gouraud_);
+        }
+        model.Submit(queue, *shader, context.depthShader(ShaderPermutation::SPACESHIP),
+                     transform, context.depthOf(getCenterPosition()), frustum);
+    }
+
+    void SubmitShadow(RenderQueue& queue, const RenderContext& context, ShadowLayer layer) override
+    {
+        if (layer != DYNAMIC_CASTERS)
+            return;
+        Shader& depthShader = context.depthShader(ShaderPermutation::SPACESHIP);
+        model.Submit(queue, depthShader, depthShader, getTransform(), context.depthOf(getCenterPosition()), &context.frustum);
+    }
+
+    bool ShadowCastersMoved(const Frustum& frustum) override
+    {
+        glm::mat4 transform = getTransform();
+        glm::vec4 bounds = getBounds(transform);
+        bool moved = transform != shadowTransform_ && (frustum.intersects(bounds) || frustum.intersects(shadowBounds_));
+        shadowTransform_ = transform;
+        shadowBounds_ = bounds;
+        return moved;
+    }
+
+    glm::mat4 getTransform()
     {
         auto center = model.getCenter();
 
@@ -89,9 +125,14 @@ public:
         m = glm::rotate(m, (float)glfwGetTime()/10, glm::vec3(0.0f, 0.0f, 1.0f));
         m = glm::translate(m, glm::vec3(-center.x * scale_factor, 0, 0));
         m = glm::scale(m, glm::vec3(scale_factor, scale_factor, scale_factor));
-        
-        shader.setMat4("model", m);
-        model.Draw(shader);
+        return m;
+    }
+
+    glm::vec4 getBounds(const glm::mat4& transform)
+    {
+        auto min_max = model.getMinMax();
+        return glm::vec4(glm::vec3(transform * glm::vec4(model.getCenter(), 1.0f)),
+                         0.5f * glm::length(min_max.second - min_max.first) * scale_factor);
     }
 
     glm::vec3 getCenterPosition()
@@ -112,6 +153,9 @@ private:
     glm::vec3 position = glm::vec3(0,0,0);
     glm::vec3 speed = glm::vec3(0, 0, 20);
     glm::vec3 lightBeginPos;
+    glm::mat4 shadowTransform_ = glm::mat4(0.0f);
+    glm::vec4 shadowBounds_ = glm::vec4(0.0f);
+    bool gouraud_ = false;
     float scale_factor = 0.01f;
     float Yaw;
     float Pitch;
@@ -0,0 +1,111 @@
+#include "StreamBuffer.hpp"
+#include "GLState.hpp"
+#include <iostream>
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr frameSize)
+    :target_(target), frameSize_(frameSize), persistent_(GLAD_GL_VERSION_4_4 != 0)
+{
+    glGenBuffers(1, &buffer_);
+    GLState::bindBuffer(target_, buffer_);
+
+    if (persistent_)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target_, frameSize_ * FrameCount, nullptr, flags);
+        mapped_ = static_cast<char*>(glMapBufferRange(target_, 0, frameSize_ * FrameCount, flags));
+    }
+    else
+        glBufferData(target_, frameSize_ * FrameCount, nullptr, GL_STREAM_DRAW);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (GLsync fence : fences_)
+        if (fence)
+            glDeleteSync(fence);
+
+    if (mapped_ || frameData_)
+    {
+        GLState::bindBuffer(target_, buffer_);
+        glUnmapBuffer(target_);
+    }
+    GLState::deleteBuffer(buffer_);
+}
+
+void StreamBuffer::beginFrame()
+{
+    frame_ = (frame_ + 1) % FrameCount;
+    used_ = 0;
+
+    GLsync& fence = fences_[frame_];
+    if (fence)
+    {
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        if (result == GL_WAIT_FAILED)
+            std::cout << "ERROR::STREAM_BUFFER::FENCE_WAIT_FAILED" << std::endl;
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    inFrame_ = true;
+    map();
+}
+
+// maps the slot from used_ on, leaving what earlier passes of this frame wrote untouched
+void StreamBuffer::map()
+{
+    mappedFrom_ = used_;
+    if (persistent_)
+        frameData_ = mapped_ + frame_ * frameSize_ + used_;
+    else if (used_ < frameSize_)
+    {
+        GLState::bindBuffer(target_, buffer_);
+        frameData_ = static_cast<char*>(glMapBufferRange(target_, frame_ * frameSize_ + used_, frameSize_ - used_,
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+    }
+}
+
+void* StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset)
+{
+    if (!frameData_ && inFrame_)
+        map();
+
+    GLsizeiptr start = (used_ + alignment - 1) / alignment * alignment;
+    if (!frameData_ || start + size > frameSize_)
+    {
+        std::cout << "ERROR::STREAM_BUFFER::OUT_OF_SPACE: " << start + size << " > " << frameSize_ << std::endl;
+        return nullptr;
+    }
+
+    used_ = start + size;
+    offset = frame_ * frameSize_ + start;
+    return frameData_ + (start - mappedFrom_);
+}
+
+void StreamBuffer::finishWrites()
+{
+    if (!persistent_ && frameData_)
+    {
+        GLState::bindBuffer(target_, buffer_);
+        glUnmapBuffer(target_);
+    }
+    frameData_ = nullptr;
+}
+
+void StreamBuffer::endFrame()
+{
+    inFrame_ = false;
+    fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLuint StreamBuffer::getBuffer() const
+{
+    return buffer_;
+}
+
+bool StreamBuffer::isPersistent() const
+{
+    return persistent_;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <glad/glad.h>
+
+class StreamBuffer
+{
+public:
+    static const int FrameCount = 3;
+
+    StreamBuffer(GLenum target, GLsizeiptr frameSize);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    void beginFrame();
+    // allocations after finishWrites() map the unused rest of the same frame's slot
+    void* allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+    void finishWrites();
+    void endFrame();
+
+    GLuint getBuffer() const;
+    bool isPersistent() const;
+
+private:
+    GLenum target_;
+    GLuint buffer_;
+    GLsizeiptr frameSize_;
+    bool persistent_;
+    char* mapped_ = nullptr;
+    char* frameData_ = nullptr;
+    GLsizeiptr mappedFrom_ = 0;
+    GLsizeiptr used_ = 0;
+    int frame_ = FrameCount - 1;
+    bool inFrame_ = false;
+    GLsync fences_[FrameCount] = {};
+
+    void map();
+};
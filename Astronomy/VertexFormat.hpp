@@ -0,0 +1,244 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "GLState.hpp"
+
+struct VertexAttribute
+{
+    GLuint location;
+    GLint components;
+    GLint columns;
+    GLenum type;
+    GLboolean normalized;
+    bool integer;
+    size_t offset;
+    size_t size;
+};
+
+template<typename T>
+struct AttributeTraits;
+
+template<GLint Components, GLenum Type, bool Integer, bool Normalized = false, GLint Columns = 1>
+struct AttributeTraitsBase
+{
+    static constexpr GLint components = Components;
+    static constexpr GLint columns = Columns;
+    static constexpr GLenum type = Type;
+    static constexpr bool integer = Integer;
+    static constexpr bool normalized = Normalized;
+};
+
+template<> struct AttributeTraits<float> : AttributeTraitsBase<1, GL_FLOAT, false> {};
+template<> struct AttributeTraits<glm::vec2> : AttributeTraitsBase<2, GL_FLOAT, false> {};
+template<> struct AttributeTraits<glm::vec3> : AttributeTraitsBase<3, GL_FLOAT, false> {};
+template<> struct AttributeTraits<glm::vec4> : AttributeTraitsBase<4, GL_FLOAT, false> {};
+template<> struct AttributeTraits<int> : AttributeTraitsBase<1, GL_INT, true> {};
+template<> struct AttributeTraits<glm::ivec4> : AttributeTraitsBase<4, GL_INT, true> {};
+template<> struct AttributeTraits<glm::mat4> : AttributeTraitsBase<4, GL_FLOAT, false, false, 4> {};
+
+struct PackedSnorm
+{
+    uint32_t bits;
+};
+
+struct PackedHalf2
+{
+    uint32_t bits;
+};
+
+struct BoneIndices
+{
+    uint16_t id[4];
+};
+
+struct BoneWeights
+{
+    uint8_t weight[4];
+};
+
+template<> struct AttributeTraits<PackedSnorm> : AttributeTraitsBase<4, GL_INT_2_10_10_10_REV, false, true> {};
+template<> struct AttributeTraits<PackedHalf2> : AttributeTraitsBase<2, GL_HALF_FLOAT, false> {};
+template<> struct AttributeTraits<BoneIndices> : AttributeTraitsBase<4, GL_UNSIGNED_SHORT, true> {};
+template<> struct AttributeTraits<BoneWeights> : AttributeTraitsBase<4, GL_UNSIGNED_BYTE, false, true> {};
+
+inline PackedSnorm packSnorm(const glm::vec4& value)
+{
+    return PackedSnorm{ glm::packSnorm3x10_1x2(glm::clamp(value, -1.0f, 1.0f)) };
+}
+
+inline PackedHalf2 packHalf(const glm::vec2& value)
+{
+    return PackedHalf2{ glm::packHalf2x16(value) };
+}
+
+template<typename T, size_t N>
+struct AttributeTraits<T[N]> : AttributeTraitsBase<static_cast<GLint>(N), AttributeTraits<T>::type, AttributeTraits<T>::integer, AttributeTraits<T>::normalized>
+{
+    static_assert(AttributeTraits<T>::components == 1, "arrays are only supported for scalar attributes");
+};
+
+template<typename T>
+constexpr VertexAttribute makeAttribute(GLuint location, size_t offset)
+{
+    return VertexAttribute{
+        location,
+        AttributeTraits<T>::components,
+        AttributeTraits<T>::columns,
+        AttributeTraits<T>::type,
+        static_cast<GLboolean>(AttributeTraits<T>::normalized ? GL_TRUE : GL_FALSE),
+        AttributeTraits<T>::integer,
+        offset,
+        sizeof(T)
+    };
+}
+
+#define VERTEX_ATTRIBUTE(Vertex, member, location) \
+    makeAttribute<decltype(Vertex::member)>(location, offsetof(Vertex, member))
+
+// Specialise for every vertex struct uploaded to the GPU:
+//     template<> struct VertexLayout<MyVertex> {
+//         static constexpr std::array<VertexAttribute, 2> attributes() {
+//             return {{ VERTEX_ATTRIBUTE(MyVertex, Position, 0), VERTEX_ATTRIBUTE(MyVertex, Normal, 1) }};
+//         }
+//     };
+template<typename V>
+struct VertexLayout;
+
+template<typename V>
+constexpr bool isValidLayout()
+{
+    const auto attributes = VertexLayout<V>::attributes();
+    for (size_t i = 0; i < attributes.size(); ++i)
+    {
+        if (attributes[i].offset + attributes[i].size > sizeof(V))
+            return false;
+        for (size_t j = 0; j < i; ++j)
+            if (attributes[j].location < attributes[i].location + attributes[i].columns &&
+                attributes[i].location < attributes[j].location + attributes[j].columns)
+                return false;
+    }
+    return true;
+}
+
+template<typename V>
+void bindVertexLayout(GLuint divisor = 0)
+{
+    static_assert(isValidLayout<V>(), "vertex layout has overlapping locations or members outside the vertex");
+
+    const auto attributes = VertexLayout<V>::attributes();
+    for (const VertexAttribute& attribute : attributes)
+    {
+        for (GLint column = 0; column < attribute.columns; ++column)
+        {
+            GLuint location = attribute.location + column;
+            size_t offset = attribute.offset + column * attribute.size / attribute.columns;
+            glEnableVertexAttribArray(location);
+            if (attribute.integer)
+                glVertexAttribIPointer(location, attribute.components, attribute.type,
+                                       sizeof(V), reinterpret_cast<void*>(offset));
+            else
+                glVertexAttribPointer(location, attribute.components, attribute.type, attribute.normalized,
+                                      sizeof(V), reinterpret_cast<void*>(offset));
+            glVertexAttribDivisor(location, divisor);
+        }
+    }
+}
+
+template<typename T>
+void createBuffer(GLenum target, const std::vector<T>& data, GLuint& buffer, GLenum usage = GL_STATIC_DRAW)
+{
+    glGenBuffers(1, &buffer);
+    GLState::bindBuffer(target, buffer);
+    glBufferData(target, data.size() * sizeof(T), data.data(), usage);
+}
+
+template<typename V>
+void attachInstanceBuffer(GLuint VAO, const std::vector<V>& instances, GLuint& buffer, GLenum usage = GL_STATIC_DRAW)
+{
+    GLState::bindVertexArray(VAO);
+    createBuffer(GL_ARRAY_BUFFER, instances, buffer, usage);
+    bindVertexLayout<V>(1);
+}
+
+template<typename V>
+GLuint createVertexArray(const std::vector<V>& vertices, GLuint& VBO)
+{
+    GLuint VAO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+
+    GLState::bindVertexArray(VAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(V), vertices.data(), GL_STATIC_DRAW);
+    bindVertexLayout<V>();
+    return VAO;
+}
+
+template<typename V, typename I>
+GLuint createVertexArray(const std::vector<V>& vertices, const std::vector<I>& indices, GLuint& VBO, GLuint& EBO)
+{
+    GLuint VAO = createVertexArray(vertices, VBO);
+
+    glGenBuffers(1, &EBO);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(I), indices.data(), GL_STATIC_DRAW);
+    return VAO;
+}
+
+const size_t MaxShortIndexVertices = 65536;
+
+struct DrawArraysIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+struct PositionNormalVertex
+{
+    glm::vec3 Position;
+    glm::vec3 Normal;
+};
+
+template<>
+struct VertexLayout<PositionNormalVertex>
+{
+    static constexpr std::array<VertexAttribute, 2> attributes()
+    {
+        return {{
+            VERTEX_ATTRIBUTE(PositionNormalVertex, Position, 0),
+            VERTEX_ATTRIBUTE(PositionNormalVertex, Normal, 1),
+        }};
+    }
+};
+
+struct QuadVertex
+{
+    glm::vec2 Corner;
+};
+
+template<>
+struct VertexLayout<QuadVertex>
+{
+    static constexpr std::array<VertexAttribute, 1> attributes()
+    {
+        return {{
+            VERTEX_ATTRIBUTE(QuadVertex, Corner, 0),
+        }};
+    }
+};
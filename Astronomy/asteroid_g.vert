@@ -1,159 +0,0 @@
-#version 410 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-uniform float fog_density;
-
-out vec3 vertex_color; 
-
-struct PointLight {
-    vec3 position;  
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-	
-    float constant;
-    float linear;
-    float quadratic;
-}; 
-
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);  
-
-struct CasterLight {
-    vec3 position;  
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-	
-    float constant;
-    float linear;
-    float quadratic;
-};
-
-vec3 CalcCasterLight(CasterLight light, vec3 normal, vec3 fragPos, vec3 viewDir);  
-
-struct DirectionalLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-vec3 CalcDirLight(DirectionalLight light, vec3 normal, vec3 viewDir);  
-
-#define NR_POINT_LIGHTS 2
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform CasterLight casterLight;
-uniform DirectionalLight directionalLight;
-
-uniform vec3 skyColor;
-uniform bool blinn;
-uniform vec3 viewPos;
-
-uniform vec3 objectColor;
-
-void main()
-{
-    vec3 Normal =  mat3(transpose(inverse(model))) * aNormal; 
-    vec4 positionRelativeToCamera = view * model * vec4(aPos, 1.0);
-    gl_Position = projection * positionRelativeToCamera;
-    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
-
-    float distance = length(positionRelativeToCamera.xyz);
-    float visibility = exp(-pow(distance*fog_density,2));
-    visibility = clamp(visibility, 0.0, 1.0);
-
-    vec3 norm = normalize(Normal);
-    vec3 viewDir = normalize(viewPos - FragPos);
-
-    vec3 result = vec3(0,0,0);
-    result += CalcDirLight(directionalLight, norm, viewDir);
-
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
-  
-    result += CalcCasterLight(casterLight, norm, FragPos, viewDir);   
-    vertex_color = mix(skyColor, result, visibility);
-}
-
-vec3 CalcDirLight(DirectionalLight light, vec3 normal, vec3 viewDir)
-{
-    vec3 lightDir = normalize(-light.direction);
-
-    float diff = max(dot(normal, lightDir), 0.0);
- 
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 8);
-
-    vec3 ambient  = light.ambient  * objectColor;
-    vec3 diffuse  = light.diffuse  * diff * objectColor;
-    vec3 specular = light.specular * spec * objectColor;
-    return (ambient + diffuse + specular);
-}  
-
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-
-    float diff = max(dot(normal, lightDir), 0.0);
-
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = 0.0;
-    if(blinn)
-    {
-        vec3 halfwayDir = normalize(lightDir + viewDir);  
-        spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
-    }
-    else
-    {
-        vec3 reflectDir = reflect(-lightDir, normal);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), 16.0);
-    }
-
-    float distance    = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + 
-  			     light.quadratic * (distance * distance));    
-
-    vec3 ambient  = light.ambient  * objectColor;
-    vec3 diffuse  = light.diffuse  * diff * objectColor;
-    vec3 specular = light.specular * spec * objectColor;
-    ambient  *= attenuation;
-    diffuse  *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
-} 
-
-vec3 CalcCasterLight(CasterLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
- 
-    float diff = max(dot(normal, lightDir), 0.0);
-
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 8);
-
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
-
-    float theta = dot(lightDir, normalize(-light.direction)); 
-    float epsilon = light.cutOff - light.outerCutOff;
-    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-
-    vec3 ambient = light.ambient * objectColor;
-    vec3 diffuse = light.diffuse * diff * objectColor;
-    vec3 specular = light.specular * spec * objectColor;
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-    return (ambient + diffuse + specular);
-}
@@ -0,0 +1,46 @@
+#version 430 core
+
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D source;
+uniform vec2 halfTexel;
+uniform float threshold;
+
+vec3 Sample(vec2 uv)
+{
+    vec3 color = texture(source, uv).rgb;
+#ifdef PREFILTER
+    // soft knee keeps the bloom from popping in as a pixel crosses the threshold
+    float brightness = max(color.r, max(color.g, color.b));
+    float knee = clamp(brightness - threshold * 0.5, 0.0, threshold);
+    float contribution = max(brightness - threshold, knee * knee / (2.0 * threshold));
+    color *= contribution / max(brightness, 1e-4);
+#endif
+    return color;
+}
+
+// dual-filter (Kawase) blur: 5 bilinear taps going down a level, 8 going up
+void main()
+{
+    vec2 uv = TexCoords;
+#ifdef UPSAMPLE
+    vec3 sum = Sample(uv + vec2(-halfTexel.x * 2.0, 0.0));
+    sum += Sample(uv + vec2(-halfTexel.x, halfTexel.y)) * 2.0;
+    sum += Sample(uv + vec2(0.0, halfTexel.y * 2.0));
+    sum += Sample(uv + vec2(halfTexel.x, halfTexel.y)) * 2.0;
+    sum += Sample(uv + vec2(halfTexel.x * 2.0, 0.0));
+    sum += Sample(uv + vec2(halfTexel.x, -halfTexel.y)) * 2.0;
+    sum += Sample(uv + vec2(0.0, -halfTexel.y * 2.0));
+    sum += Sample(uv + vec2(-halfTexel.x, -halfTexel.y)) * 2.0;
+    FragColor = vec4(sum / 12.0, 1.0);
+#else
+    vec3 sum = Sample(uv) * 4.0;
+    sum += Sample(uv - halfTexel);
+    sum += Sample(uv + halfTexel);
+    sum += Sample(uv + vec2(halfTexel.x, -halfTexel.y));
+    sum += Sample(uv - vec2(halfTexel.x, -halfTexel.y));
+    FragColor = vec4(sum / 8.0, 1.0);
+#endif
+}
@@ -0,0 +1,33 @@
+#version 430 core
+
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform sampler2D bloom;
+uniform float bloomIntensity;
+uniform float exposure;
+
+const float ShoulderStart = 0.6;
+
+// Reinhard on the part above ShoulderStart, so the LDR range stays linear and HDR values roll off towards white;
+// applied to the brightest channel so bright stars keep their hue
+vec3 Tonemap(vec3 color)
+{
+    color *= exposure;
+    float peak = max(color.r, max(color.g, color.b));
+    if (peak <= ShoulderStart)
+        return color;
+    float excess = peak - ShoulderStart;
+    float mapped = ShoulderStart + excess / (1.0 + excess / (1.0 - ShoulderStart));
+    return color * (mapped / peak);
+}
+
+void main()
+{
+    vec3 color = texture(scene, TexCoords).rgb;
+    if (bloomIntensity > 0.0)
+        color += texture(bloom, TexCoords).rgb * bloomIntensity;
+    FragColor = vec4(Tonemap(color), 1.0);
+}
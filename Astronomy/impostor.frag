@@ -0,0 +1,38 @@
+#version 430 core
+
+in vec3 RayTarget;
+flat in vec3 Center;
+flat in float Radius;
+flat in vec3 InstanceColor;
+flat in int LightingTile;
+#define objectColor InstanceColor
+#define lightingTile LightingTile
+
+out vec4 FragColor;
+
+#include "lighting.glsl"
+
+void main()
+{
+    vec3 rayDir = normalize(RayTarget - viewPos);
+    vec3 oc = viewPos - Center;
+    float b = dot(oc, rayDir);
+    float c = dot(oc, oc) - Radius * Radius;
+    float h = b * b - c;
+    if (h < 0.0)
+        discard;
+
+    vec3 fragPos = viewPos + rayDir * (-b - sqrt(h));
+    vec3 norm = normalize(fragPos - Center);
+
+    vec4 viewPosition = view * vec4(fragPos, 1.0);
+    vec4 clipPosition = projection * viewPosition;
+    float ndcDepth = clipPosition.z / clipPosition.w;
+    gl_FragDepth = (gl_DepthRange.diff * ndcDepth + gl_DepthRange.near + gl_DepthRange.far) * 0.5;
+
+#ifndef DEPTH_ONLY
+    float visibility = CalcVisibility(length(viewPosition.xyz));
+    vec3 result = Shade(norm, fragPos, vec2(0.0));
+    FragColor = mix(vec4(skyColor, 1.0), vec4(result, 1.0), visibility);
+#endif
+}
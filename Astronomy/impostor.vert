@@ -0,0 +1,37 @@
+#version 430 core
+layout (location = 0) in vec2 aCorner;
+layout (location = 8) in vec3 aCenter;
+layout (location = 9) in float aRadius;
+layout (location = 12) in vec3 aInstanceColor;
+layout (location = 13) in int aLightingTile;
+#define objectColor aInstanceColor
+#define lightingTile aLightingTile
+
+#include "lighting.glsl"
+
+out vec3 RayTarget;
+flat out vec3 Center;
+flat out float Radius;
+flat out vec3 InstanceColor;
+flat out int LightingTile;
+invariant gl_Position;
+
+void main()
+{
+    vec3 toCenter = aCenter - viewPos;
+    float distance = length(toCenter);
+    vec3 forward = toCenter / distance;
+    vec3 right = normalize(cross(forward, abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+    vec3 up = cross(right, forward);
+
+    // half-size of the quad through the centre that covers the sphere's silhouette cone
+    float extent = aRadius * distance / sqrt(max(distance * distance - aRadius * aRadius, 1e-4));
+    vec3 corner = aCenter + (right * aCorner.x + up * aCorner.y) * extent;
+
+    RayTarget = corner;
+    Center = aCenter;
+    Radius = aRadius;
+    InstanceColor = aInstanceColor;
+    LightingTile = aLightingTile;
+    gl_Position = projection * view * vec4(corner, 1.0);
+}
@@ -0,0 +1,235 @@
+#include "point_lights.glsl"
+
+struct CasterLight {
+    vec3 position;  
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+  
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+	
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirectionalLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+layout (std140) uniform SceneData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    float fog_density;
+    vec3 skyColor;
+    uvec4 clusterGrid;
+    vec4 clusterDepth;
+    CasterLight casterLight;
+    DirectionalLight directionalLight;
+    mat4 casterShadow;
+};
+
+layout (std430, binding = 5) readonly buffer LightClusters
+{
+    uvec2 clusters[];
+};
+
+layout (std430, binding = 6) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+
+#ifdef TEXTURED
+uniform sampler2D texture_diffuse1;
+#endif
+uniform sampler2DShadow casterShadowMap;
+#ifdef LIGHTING_CACHE
+uniform sampler2DArray lightingCache;
+#endif
+
+// receivers are pushed along the normal by a few shadow texels, which grow with the distance to the light
+const float ShadowNormalOffset = 0.003;
+// stars are emissive, well above the bloom threshold of the HDR target
+const float StarIntensity = 4.0;
+
+float CalcVisibility(float distance)
+{
+    float visibility = exp(-pow(distance*fog_density,2));
+    return clamp(visibility, 0.0, 1.0);
+}
+
+vec3 CalcDirLight(DirectionalLight light, vec3 normal, vec3 viewDir, vec3 albedo)
+{
+    vec3 lightDir = normalize(-light.direction);
+
+    float diff = max(dot(normal, lightDir), 0.0);
+ 
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 8);
+
+    vec3 ambient  = light.ambient  * albedo;
+    vec3 diffuse  = light.diffuse  * diff * albedo;
+    vec3 specular = light.specular * spec * albedo;
+    return (ambient + diffuse + specular);
+}  
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+
+    float diff = max(dot(normal, lightDir), 0.0);
+
+#ifdef BLINN
+    vec3 halfwayDir = normalize(lightDir + viewDir);  
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), 2.0 * SHININESS);
+#else
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), SHININESS);
+#endif
+
+    float attenuation = CalcAttenuation(light, length(light.position - fragPos));
+    float occlusion = CalcOcclusion(light, fragPos);
+
+    vec3 ambient  = light.ambient  * albedo;
+    vec3 diffuse  = light.diffuse  * diff * albedo;
+    vec3 specular = light.specular * spec * albedo;
+    ambient  *= attenuation;
+    diffuse  *= attenuation * occlusion;
+    specular *= attenuation * occlusion;
+    return (ambient + diffuse + specular);
+} 
+
+#ifdef LIGHTING_CACHE
+// point lights read from the sphere's lighting tile, false until the tile has been filled
+bool CalcCachedPointLights(int tile, vec3 normal, vec3 viewDir, vec3 albedo, out vec3 result)
+{
+    result = vec3(0.0);
+    if (tile < 0)
+        return false;
+
+    // stay half a texel inside the tile so filtering never reads a neighbour
+    vec2 tileTexel = clamp(LightingTileCoords(normal) * vec2(LIGHTING_TILE_SIZE), vec2(0.5), vec2(LIGHTING_TILE_SIZE) - 0.5);
+    vec2 texel = vec2(ivec2(tile % LIGHTING_TILE_COLUMNS, tile / LIGHTING_TILE_COLUMNS) * LIGHTING_TILE_SIZE) + tileTexel;
+    vec2 uv = texel / vec2(textureSize(lightingCache, 0).xy);
+    vec4 irradiance = textureLod(lightingCache, vec3(uv, IrradianceLayer), 0.0);
+    if (irradiance.a < 0.5)
+        return false;
+    vec3 specularColor = textureLod(lightingCache, vec3(uv, SpecularLayer), 0.0).rgb;
+    vec3 direction = textureLod(lightingCache, vec3(uv, LightDirectionLayer), 0.0).xyz;
+
+    float spec = 0.0;
+    if (dot(direction, direction) > 0.0)
+    {
+        vec3 lightDir = normalize(direction);
+#ifdef BLINN
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        spec = pow(max(dot(normal, halfwayDir), 0.0), 2.0 * SHININESS);
+#else
+        vec3 reflectDir = reflect(-lightDir, normal);
+        spec = pow(max(dot(viewDir, reflectDir), 0.0), SHININESS);
+#endif
+    }
+    result = (irradiance.rgb + specularColor * spec) * albedo;
+    return true;
+}
+#endif
+
+float CalcCasterShadow(vec3 fragPos)
+{
+    vec4 shadowPosition = casterShadow * vec4(fragPos, 1.0);
+    if (shadowPosition.w <= 0.0)
+        return 1.0;
+    vec3 coords = shadowPosition.xyz / shadowPosition.w;
+    if (coords.z >= 1.0)
+        return 1.0;
+    return texture(casterShadowMap, coords);
+}
+
+vec3 CalcCasterLight(CasterLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+ 
+    float diff = max(dot(normal, lightDir), 0.0);
+
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 8);
+
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+
+    float theta = dot(lightDir, normalize(-light.direction)); 
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * albedo;
+    ambient *= attenuation * intensity;
+    float shadow = CalcCasterShadow(fragPos + normal * (ShadowNormalOffset * distance));
+    diffuse *= attenuation * intensity * shadow;
+    specular *= attenuation * intensity * shadow;
+    return (ambient + diffuse + specular);
+}
+
+// cluster (first index, light count) of a world-space position; outside the frustum every light applies
+bool FindCluster(vec3 fragPos, out uvec2 cluster)
+{
+    vec4 viewPosition = view * vec4(fragPos, 1.0);
+    vec4 clipPosition = projection * viewPosition;
+    vec3 ndc = clipPosition.xyz / clipPosition.w;
+    if (clipPosition.w <= 0.0 || any(greaterThan(abs(ndc), vec3(1.0))))
+        return false;
+
+    vec3 cell = vec3(vec2(clusterGrid.xy) * (ndc.xy * 0.5 + 0.5), log(-viewPosition.z) * clusterDepth.x + clusterDepth.y);
+    uvec3 index = min(uvec3(max(cell, vec3(0.0))), clusterGrid.xyz - 1u);
+    cluster = clusters[(index.z * clusterGrid.y + index.y) * clusterGrid.x + index.x];
+    return true;
+}
+
+vec3 Shade(vec3 normal, vec3 fragPos, vec2 texCoords)
+{
+#ifdef TEXTURED
+    vec3 albedo = vec3(texture(texture_diffuse1, texCoords));
+#else
+    vec3 albedo = objectColor;
+#endif
+
+#if defined(STAR)
+    return albedo * StarIntensity;
+#elif defined(FALLBACK)
+    return albedo;
+#else
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 result = vec3(0,0,0);
+    result += CalcDirLight(directionalLight, normal, viewDir, albedo);
+
+#ifdef LIGHTING_CACHE
+    vec3 cached;
+    if (CalcCachedPointLights(lightingTile, normal, viewDir, albedo, cached))
+        result += cached;
+    else
+#endif
+    {
+        uvec2 cluster;
+        bool clustered = FindCluster(fragPos, cluster);
+        uint lightCount = clustered ? cluster.y : clusterGrid.w;
+        for(uint i = 0u; i < lightCount; i++)
+        {
+            uint light = clustered ? lightIndices[cluster.x + i] : i;
+            result += CalcPointLight(pointLights[light], normal, fragPos, viewDir, albedo);
+        }
+    }
+  
+    result += CalcCasterLight(casterLight, normal, fragPos, viewDir, albedo);
+    return result;
+#endif
+}
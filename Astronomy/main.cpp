@@ -1,13 +1,18 @@
 #include "MainApp.hpp"
 
-int main()
+int main(int argc, char** argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-culling")
+    {
+        FrustumCuller::benchmark(100000, 1000);
+        return 0;
+    }
+
     try {
         glfwInit();
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-        glfwWindowHint(GLFW_SAMPLES, 4);
 
         GLFWwindow* window = glfwCreateWindow(MainApp::window_data.width, MainApp::window_data.height, MainApp::window_data.title.c_str(), nullptr, nullptr);
 
@@ -19,12 +24,13 @@ int main()
         if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress)))
             throw std::exception("Failed to initialize GLAD");
 
-        MainApp app(window);
+        MainApp app(window, argc > 1 && std::string(argv[1]) == "--star-field");
         app.mainLoop();
     } catch (std::exception& e) {
         std::cout << "Error: " << e.what() << std::endl;
     }
 
+    GeometryMemory::shutdown();
     glfwTerminate();
 
     return 0;
@@ -0,0 +1,37 @@
+#version 430 core
+
+#ifdef GOURAUD
+in vec3 vertex_color;   
+#else
+in float visibility;
+in vec2 TexCoords;
+in vec3 Normal;  
+in vec3 FragPos; 
+#ifdef SPHERE
+flat in vec3 InstanceCenter;
+#endif
+#endif
+flat in vec3 InstanceColor;
+flat in int LightingTile;
+#define objectColor InstanceColor
+#define lightingTile LightingTile
+
+out vec4 FragColor;
+
+#include "lighting.glsl"
+
+void main()
+{    
+#if defined(DEPTH_ONLY)
+#elif defined(GOURAUD)
+    FragColor = vec4(vertex_color, 1.0);   
+#else
+#ifdef SPHERE
+    vec3 norm = normalize(FragPos - InstanceCenter);
+#else
+    vec3 norm = normalize(Normal);
+#endif
+    vec3 result = Shade(norm, FragPos, TexCoords);
+    FragColor = mix(vec4(skyColor, 1.0), vec4(result, 1.0), visibility);
+#endif
+}
@@ -1,28 +1,57 @@
-#version 410 core
+#version 430 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 8) in mat4 aInstanceModel;
+layout (location = 12) in vec3 aInstanceColor;
+layout (location = 13) in int aLightingTile;
+#define model aInstanceModel
+#define objectColor aInstanceColor
+#define lightingTile aLightingTile
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-uniform float fog_density;
+#include "lighting.glsl"
 
+#ifdef GOURAUD
+out vec3 vertex_color; 
+#else
 out vec3 FragPos; 
 out vec2 TexCoords;
 out vec3 Normal;
 out float visibility;
+#ifdef SPHERE
+flat out vec3 InstanceCenter;
+#endif
+#endif
+flat out vec3 InstanceColor;
+flat out int LightingTile;
+invariant gl_Position;
 
 void main()
 {
-    TexCoords = aTexCoords;  
-    Normal =  mat3(transpose(inverse(model))) * aNormal; 
     vec4 positionRelativeToCamera = view * model * vec4(aPos, 1.0);
     gl_Position = projection * positionRelativeToCamera;
-    FragPos = vec3(model * vec4(aPos, 1.0));
+#ifndef DEPTH_ONLY
+    vec3 fragPos = vec3(model * vec4(aPos, 1.0));
+    float fog = CalcVisibility(length(positionRelativeToCamera.xyz));
 
-    float distance = length(positionRelativeToCamera.xyz);
-    visibility = exp(-pow(distance*fog_density,2));
-    visibility = clamp(visibility, 0.0, 1.0);
-}
\ No newline at end of file
+#ifdef GOURAUD
+#ifdef SPHERE
+    vec3 norm = normalize(fragPos - model[3].xyz);
+#else
+    vec3 norm = normalize(mat3(transpose(inverse(model))) * aNormal);
+#endif
+    vertex_color = mix(skyColor, Shade(norm, fragPos, aTexCoords), fog);
+#else
+    TexCoords = aTexCoords;  
+#ifdef SPHERE
+    InstanceCenter = model[3].xyz;
+#else
+    Normal =  mat3(transpose(inverse(model))) * aNormal; 
+#endif
+    FragPos = fragPos;
+    visibility = fog;
+#endif
+    InstanceColor = aInstanceColor;
+    LightingTile = aLightingTile;
+#endif
+}
@@ -0,0 +1,76 @@
+struct PointLight {
+    vec3 position;
+    float radius;
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+    uint firstOccluder;
+    uint occluderCount;
+    float sourceRadius;
+};
+
+layout (std430, binding = 4) readonly buffer PointLights
+{
+    PointLight pointLights[];
+};
+
+layout (std430, binding = 7) readonly buffer Occluders
+{
+    vec4 occluders[];
+};
+
+// inverse-square falloff windowed to reach zero at the light's radius
+float CalcAttenuation(PointLight light, float distance)
+{
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    return attenuation * window * window;
+}
+
+// fraction of the light's disc left uncovered by the occluding spheres, compared as cones from fragPos
+float CalcOcclusion(PointLight light, vec3 fragPos)
+{
+    vec3 toLight = light.position - fragPos;
+    float lightDistance = length(toLight);
+    vec3 lightDir = toLight / lightDistance;
+    float lightAngle = max(asin(clamp(light.sourceRadius / lightDistance, 0.0, 1.0)), 1e-4);
+
+    float visibility = 1.0;
+    for (uint i = 0u; i < light.occluderCount; i++)
+    {
+        vec4 occluder = occluders[light.firstOccluder + i];
+        vec3 toOccluder = occluder.xyz - fragPos;
+        float occluderDistance = length(toOccluder);
+        if (dot(toOccluder, lightDir) <= 0.0 || occluderDistance - occluder.w >= lightDistance)
+            continue;
+
+        float occluderAngle = asin(clamp(occluder.w / occluderDistance, 0.0, 1.0));
+        float separation = acos(clamp(dot(toOccluder / occluderDistance, lightDir), -1.0, 1.0));
+        float covered = min(occluderAngle, lightAngle) / lightAngle;
+        visibility *= 1.0 - covered * covered * smoothstep(lightAngle + occluderAngle, abs(lightAngle - occluderAngle), separation);
+    }
+    return visibility;
+}
+
+#ifdef LIGHTING_CACHE
+// a sphere's lighting tile maps its surface by latitude and longitude of the world-space normal
+const float Pi = 3.14159265;
+const int IrradianceLayer = 0;
+const int SpecularLayer = 1;
+const int LightDirectionLayer = 2;
+
+vec3 LightingTileNormal(vec2 uv)
+{
+    float longitude = (uv.x - 0.5) * 2.0 * Pi;
+    float colatitude = uv.y * Pi;
+    return vec3(sin(colatitude) * cos(longitude), sin(colatitude) * sin(longitude), cos(colatitude));
+}
+
+vec2 LightingTileCoords(vec3 normal)
+{
+    return vec2(atan(normal.y, normal.x) / (2.0 * Pi) + 0.5, acos(clamp(normal.z, -1.0, 1.0)) / Pi);
+}
+#endif